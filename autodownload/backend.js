@@ -21,23 +21,39 @@ async function fetch_body(qnumber) {
 }
 
 function onResponse(response) {
-  console.log("Received " + response);
+  console.log("Received " + JSON.stringify(response));
 }
 
 function onError(error) {
   console.log(`Error: ${error}`);
 }
 
+/**
+ * The port to the companion native application.  It is opened
+ * on first use and kept open, so that one autoproject process
+ * serves every question instead of one being started for each.
+ */
+var port = null;
+
+function native_port() {
+    if (port === null) {
+        port = browser.runtime.connectNative("com.beroset.autoproject");
+        port.onMessage.addListener(onResponse);
+        port.onDisconnect.addListener(p => {
+            if (p.error) {
+                onError(p.error.message);
+            }
+            port = null;
+        });
+    }
+    return port;
+}
+
 /**
  * Given a question number message, fetch the associated
  * json and send it to the companion native application.
  * 
  */
 function log_md(message) {
-    fetch_body(message.qnumber).then(md => {
-        var sending = browser.runtime.sendNativeMessage(
-            "com.beroset.autoproject",
-            md);
-        sending.then(onResponse, onError);
-    });
+    fetch_body(message.qnumber).then(md => native_port().postMessage(md), onError);
 }
@@ -0,0 +1,90 @@
+/*
+ * Extraction microbenchmark.
+ *
+ * Generates a large synthetic markdown file mixing prose, indented and
+ * fenced source files and then times AutoProject::createProject on it,
+ * reporting lines per second.  By default an empty rules file is used so
+ * that the figure reflects the markdown scanner rather than the rules.
+ *
+ * Usage: ExtractBench [megabytes [rulesfile]]
+ */
+#include "AutoProject.h"
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+static std::size_t generate(const fs::path& mdfile, std::size_t bytes) {
+    std::ofstream out{mdfile};
+    std::size_t lines{0};
+    auto put = [&](const std::string& line) {
+        out << line << '\n';
+        ++lines;
+    };
+    put("# [Synthetic benchmark question](https://codereview.stackexchange.com/questions/1)");
+    put("### tags: ['c++', 'performance']");
+    put("");
+    for (unsigned file{0}; static_cast<std::size_t>(out.tellp()) < bytes; ++file) {
+        put("Here is some prose describing the next file, which is rather long.");
+        put("");
+        put("**file" + std::to_string(file) + ".cpp**");
+        put("");
+        put("    #include <vector>");
+        put("    #include <thread>");
+        put("    #include \"file" + std::to_string(file) + ".h\"");
+        for (unsigned i{0}; i < 200; ++i) {
+            put((i % 7 ? "        " : "\t\t") + std::string{"int value"} + std::to_string(i) + " = compute(" + std::to_string(i) + ");");
+            if (i % 25 == 0) {
+                put("");
+            }
+        }
+        put("");
+        put("And a delimited one:");
+        put("");
+        put("file" + std::to_string(file) + ".h");
+        put("```c++");
+        put("#include <png.h>");
+        for (unsigned i{0}; i < 200; ++i) {
+            put((i % 5 ? "    " : "\t") + std::string{"double other"} + std::to_string(i) + " = value" + std::to_string(i) + " * 2.0;");
+        }
+        put("```");
+        put("---");
+    }
+    return lines;
+}
+
+int main(int argc, char *argv[]) {
+    const std::size_t megabytes{argc > 1 ? std::stoul(argv[1]) : 100};
+    const fs::path workdir{fs::temp_directory_path() / "autoproject_bench"};
+    fs::remove_all(workdir);
+    fs::create_directories(workdir);
+    fs::path rulesfile{workdir / "rules.txt"};
+    if (argc > 2) {
+        rulesfile = argv[2];
+    } else {
+        std::ofstream{rulesfile};
+    }
+    const fs::path configdir{BENCH_CONFIG_DIR "/cpp"};
+    LangConfig config;
+    config.configdir = configdir;
+    config.rulesfilename = rulesfile;
+    config.toplevelcmakefilename = configdir / "toplevel.cmake.txt";
+    config.srclevelcmakefilename = configdir / "srclevel.cmake.txt";
+    const std::map<std::string, LangConfig> lang{ { "c++", config } };
+    const fs::path mdfile{workdir / "bench.md"};
+    const auto lines{generate(mdfile, megabytes << 20)};
+    const auto bytes{fs::file_size(mdfile)};
+
+    const auto start{std::chrono::steady_clock::now()};
+    AutoProject ap{mdfile, lang};
+    ap.createProject(true);
+    const std::chrono::duration<double> elapsed{std::chrono::steady_clock::now() - start};
+
+    const auto seconds{elapsed.count()};
+    std::cout << std::fixed << std::setprecision(3)
+        << "Extracted " << lines << " lines (" << bytes / 1e6 << " MB) in " << seconds << " s: "
+        << std::setprecision(0) << lines / seconds << " lines/s, "
+        << std::setprecision(1) << bytes / 1e6 / seconds << " MB/s\n";
+    fs::remove_all(workdir);
+}
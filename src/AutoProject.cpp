@@ -1,8 +1,20 @@
 #include <config.h>
 #include "AutoProject.h"
+#include "BuildFile.h"
+#include "BuildPool.h"
+#include "Hash.h"
+#include "InitialCache.h"
+#include "Json.h"
+#include "Process.h"
+#include "RuleSet.h"
+#include "SharedHeader.h"
+#include "Template.h"
+#include "Tool.h"
 #include <unordered_set>
 #include <algorithm>
 #include <iostream>
+#include <iterator>
+#include <mutex>
 #include <regex>
 #include <sstream>
 #include <vector>
@@ -10,43 +22,93 @@
 
 using namespace std::literals;
 
-// local definitions
-struct Rule {
-    const std::regex re;
-    const std::string cmake;
-    const std::string libraries;
-    static const std::regex newline;
-    Rule(std::string reg, std::string result, std::string libraries) : re{reg}, 
-        cmake{std::regex_replace(result, newline, "\n")},
-        libraries{libraries} {
-    }
-};
-
-// helper functions
-static std::string& trim(std::string& str, const std::string_view pattern);
-static std::string& rtrim(std::string& str, const std::string_view pattern);
-static std::string& trim(std::string& str, char ch);
-static std::string& rtrim(std::string& str, char ch);
-static std::string trimExtras(std::string& line);
-static bool isNonEmptyIndented(const std::string& line);
-static bool isIndentedOrEmpty(const std::string& line);
-static bool isEmptyOrUnderline(const std::string& line);
-static bool isDelimited(const std::string& line);
-static bool isSourceExtension(const std::string_view ext);
-static bool isSourceFilename(std::string& line);
-static std::string &replaceLeadingTabs(std::string& line);
-static void emit(std::ostream& out, const std::string& line);
-static std::vector<Rule> loadrules(const fs::path& rulesfile);
-
 // local constants
 static const std::string mdextension{".md"};
 static constexpr std::string_view cmakeVersion{"VERSION 3.1"};
 static constexpr unsigned indentLevel{4};
 static constexpr unsigned delimLength{3};
-const std::regex Rule::newline{R"(\\n)"};
+static const fs::path manifestName{"autoproject.manifest"};
+// a precompiled header is only worth building for at least this many sources
+static constexpr std::size_t pchMinSources{3};
+// and only holds the system headers that at least this many of them include
+static constexpr std::size_t pchMinIncluders{2};
+static constexpr std::string_view manifestTag{"autoproject manifest"};
+
+/*! One line of the markdown input as a view into the input buffer.
+ *
+ * Leading tabs are not expanded into a copy of the line.  Instead `tabs`
+ * counts them, each standing for `indentLevel` spaces, and `text` is the
+ * remainder of the line.
+ */
+struct Line {
+    std::size_t tabs = 0;
+    std::string_view text;
+    bool empty() const { return tabs == 0 && text.empty(); }
+    std::size_t size() const { return tabs * indentLevel + text.size(); }
+    /// column of the first non-space character after expanding tabs, or npos
+    std::size_t indent() const {
+        auto pos{text.find_first_not_of(' ')};
+        return pos == std::string_view::npos ? pos : tabs * indentLevel + pos;
+    }
+};
 
-// local variables
-static std::vector<Rule> rules;
+/// the kinds of markdown line that matter for extraction
+enum class LineClass {
+    fence,      // ``` or ~~~ delimiter
+    code,       // indented at least indentLevel with something after it
+    blank,      // nothing but spaces and tabs
+    empty,      // nothing at all
+    underline,  // nothing but dashes
+    text,       // anything else
+};
+static constexpr unsigned lineClasses{static_cast<unsigned>(LineClass::text) + 1};
+
+/// where the extractor is within the markdown
+enum class State { prose, indented, fenced };
+static constexpr unsigned states{static_cast<unsigned>(State::fenced) + 1};
+
+/// what the extractor does with a line
+enum class Action {
+    ignore,         // skip it
+    remember,       // check it for language tags and keep it as a possible filename
+    openFenced,     // start a delimited source file
+    openIndented,   // start an indented source file with this line
+    emit,           // write it with one indent level removed
+    write,          // write it verbatim
+    close,          // finish the current source file
+};
+
+static constexpr Action transitions[states][lineClasses]{
+    //  fence                 code                    blank             empty             underline         text
+    { Action::openFenced, Action::openIndented, Action::remember, Action::ignore, Action::ignore, Action::remember },  // prose
+    { Action::close,      Action::emit,         Action::emit,     Action::emit,   Action::close,  Action::close    },  // indented
+    { Action::close,      Action::write,        Action::write,    Action::write,  Action::write,  Action::write    },  // fenced
+};
+
+// helper functions
+static LineClass classify(const Line& line);
+static std::string_view trim(std::string_view str, const std::string_view pattern);
+static std::string_view rtrim(std::string_view str, const std::string_view pattern);
+static std::string_view trim(std::string_view str, char ch);
+static std::string_view rtrim(std::string_view str, char ch);
+static std::string_view trimExtras(std::string_view line);
+static Line nextLine(std::string_view& input);
+static bool isSourceExtension(const std::string_view ext);
+static bool isHeaderExtension(const std::string_view ext);
+static bool isSourceFilename(std::string_view& line);
+static bool sameContents(const fs::path& filename, std::string_view data);
+static bool unitySafe(std::string_view text);
+static std::vector<std::string> definedTypes(std::string_view text);
+static std::string_view nameOf(Profile profile);
+static std::string profileCommands(Profile profile);
+static std::string profileFlags(Profile profile);
+static std::string fileDigest(const fs::path& filename);
+static std::string contentDigest(const fs::path& filename);
+static std::string packageCommands(const RuleSet& rules);
+static std::vector<std::string> launcherCommand(const LangConfig& config);
+static void spaces(std::string& out, std::size_t count);
+static void write(std::string& out, const Line& line);
+static void emit(std::string& out, const Line& line);
 
 // AutoProject interface functions
 void AutoProject::open(fs::path mdFilename, std::map<std::string, LangConfig> lang) {
@@ -55,19 +117,37 @@ void AutoProject::open(fs::path mdFilename, std::map<std::string, LangConfig> la
 }
 
 AutoProject::AutoProject(fs::path mdFilename, std::map<std::string, LangConfig> lang) :
+    AutoProject(mdFilename, std::string{}, lang)
+{
+    mapped = MappedFile{mdfile};
+}
+
+AutoProject::AutoProject(fs::path mdFilename, std::string mdContents, std::map<std::string, LangConfig> lang) :
     mdfile{mdFilename},
     outdir{mdFilename.replace_extension("")},
     projname{mdfile.stem().string()},
     srcdir{outdir.string() + "/src"},
-    in{mdfile},
+    mdtext{std::move(mdContents)},
     lang{lang}
 {
     if (mdfile.extension() != mdextension) {
         throw FileExtensionException("Input file must have " + mdextension + " extension");
     }
-    if (!in) {
-        throw std::runtime_error("Cannot open input file "s + mdfile.string());
+}
+
+std::string_view AutoProject::contents() const {
+    return mdtext.empty() ? mapped.view() : std::string_view{mdtext};
+}
+
+std::string AutoProject::mainSourceName() const {
+    if (thislang == "c") {
+        return "main.c";
+    } else if (thislang == "c++") {
+        return "main.cpp";
+    } else if (thislang == "asm") {
+        return "main.asm";
     }
+    return {};
 }
 
 /*
@@ -77,116 +157,344 @@ AutoProject::AutoProject(fs::path mdFilename, std::map<std::string, LangConfig>
  * tag and unindented code is now supported in addition to the original
  * indented flavor.  As a result, this code is modified to also accept
  * that syntax as of April 2019.
+ *
+ * Each line is classified once and the `transitions` table then says
+ * what to do with it, given whether we are in prose, in an indented
+ * source file or in a delimited (fenced) source file.
  */
-bool AutoProject::createProject(bool overwrite) {
-    std::string prevline;
-    bool inIndentedFile{false};
-    bool inDelimitedFile{false};
+bool AutoProject::createProject(bool overwrite, bool incremental) {
+    this->incremental = incremental;
+    // a forced overwrite asks for every file to be written anew
+    const bool memoize{incremental || !overwrite};
+    overwrite = overwrite || incremental;
+    unchanged = 0;
+    outputs.clear();
+    const auto mdDigest{hexDigest(fnv1a(contents()))};
+    if (memoize && readManifest(mdDigest)) {
+        return true;
+    }
+    std::string_view prevline;
+    State state{State::prose};
     bool firstFile{true};
-    std::ofstream srcfile;
+    // the source file being extracted, written out when it is finished
     fs::path srcfilename;
-    // TODO: this might be much cleaner with a state machine
-    for (std::string line; getline(in, line); ) {
-        replaceLeadingTabs(line);
-        // scan through looking for lines indented with indentLevel spaces
-        if (inIndentedFile) {
-            // stop writing if non-indented line or EOF
-            if (!isIndentedOrEmpty(line)) {
-                std::swap(prevline, line);
-                srcfile.close();
-                inIndentedFile = false;
-            } else {
-                checkRules(line);
-                emit(srcfile, line);
-            }
-        } else if (inDelimitedFile) {
-            // stop writing if delimited line
-            if (isDelimited(line)) {
-                std::swap(prevline, line);
-                srcfile.close();
-                inDelimitedFile = false;
-            } else {
-                checkRules(line);
-                srcfile << line << '\n';
+    std::string srctext;
+    // start collecting the named source file, creating the tree first if needed
+    auto startFile = [&](const fs::path& name) {
+        if (firstFile) {
+            makeTree(overwrite);
+            // from here on the old manifest no longer describes the output
+            std::error_code ec;
+            fs::remove(outdir / manifestName, ec);
+            firstFile = false;
+        }
+        if (name.empty()) {
+            return false;
+        }
+        srcfilename = fs::path(srcdir) / name;
+        srctext.clear();
+        scan = {};
+        if (std::find(srcnames.begin(), srcnames.end(), srcfilename.filename()) == srcnames.end()) {
+            srcnames.push_back(srcfilename.filename());
+        }
+        return true;
+    };
+    // the language may not be known until the sources are, so check them all if any language wants it
+    const bool anyUnity{std::any_of(lang.begin(), lang.end(), [](const auto& config){ return config.second.unity; })};
+    // add `name` to `names` unless it is already there
+    auto note = [](std::vector<fs::path>& names, const fs::path& name) {
+        if (std::find(names.begin(), names.end(), name) == names.end()) {
+            names.push_back(name);
+        }
+    };
+    auto finishFile = [&]{
+        if (srcfilename.empty()) {
+            return;
+        }
+        const auto name{srcfilename.filename()};
+        if (!writeFile(srcfilename, srctext)) {
+            srcnames.erase(std::find(srcnames.begin(), srcnames.end(), name));
+            srcfilename.clear();
+            return;
+        }
+        srcfilename.clear();
+        auto& edges{localIncludes[name]};
+        edges.insert(edges.end(), scan.locals.begin(), scan.locals.end());
+        if (isHeaderExtension(name.extension().string())) {
+            return;
+        }
+        if (anyUnity && !unitySafe(srctext)) {
+            note(unityExcluded, name);
+        }
+        if (anyUnity) {
+            for (const auto& type : definedTypes(srctext)) {
+                note(typeDefiners[type], name);
             }
-        } else {
-            if (isDelimited(line)) {
+        }
+        for (const auto& header : scan.headers) {
+            ++systemHeaders[header];
+        }
+        if (scan.definesFirst) {
+            pchExcluded.push_back(name);
+        }
+        if (scan.main) {
+            note(entryPoints, name);
+        }
+    };
+    for (std::string_view input{contents()}; !input.empty(); ) {
+        const Line line{nextLine(input)};
+        switch (transitions[static_cast<unsigned>(state)][static_cast<unsigned>(classify(line))]) {
+            case Action::ignore:
+                break;
+            case Action::remember:
+                checkLanguageTags(line.text);
+                prevline = line.text;
+                break;
+            case Action::openFenced:
                 // if previous line was filename, open that file and start writing
-                if (isSourceFilename(prevline)) {
-                    srcfilename = fs::path(srcdir) / prevline;
-                } else {
-                    if (thislang == "c") {
-                        srcfilename = fs::path(srcdir) / "main.c";
-                    } else if (thislang == "c++") {
-                        srcfilename = fs::path(srcdir) / "main.cpp";
-                    } else if (thislang == "asm") {
-                        srcfilename = fs::path(srcdir) / "main.asm";
-                    } 
-                }
-                if (firstFile) {
-                    makeTree(overwrite);
-                    firstFile = false;
+                if (startFile(isSourceFilename(prevline) ? fs::path(prevline) : fs::path(mainSourceName()))) {
+                    state = State::fenced;
                 }
-                srcfile.open(srcfilename);
-                if (srcfile) {
-                    srcnames.emplace(srcfilename.filename());
-                    inDelimitedFile = true;
-                }
-            } else if (isNonEmptyIndented(line)) {
+                break;
+            case Action::openIndented: {
                 // if previous line was filename, open that file and start writing
+                fs::path name;
                 if (isSourceFilename(prevline)) {
-                    if (firstFile) {
-                        makeTree(overwrite);
-                        firstFile = false;
-                    }
-                    srcfilename = fs::path(srcdir) / prevline;
-                    srcfile.open(srcfilename);
-                    if (srcfile) {
-                        checkRules(line);
-                        emit(srcfile, line);
-                        srcnames.emplace(srcfilename.filename());
-                        inIndentedFile = true;
-                    }
-                } else if (firstFile && !line.empty()) {  // un-named source file
-                    makeTree(overwrite);
-                    firstFile = false;
-                    if (thislang == "c") {
-                        srcfilename = fs::path(srcdir) / "main.c";
-                    } else if (thislang == "c++") {
-                        srcfilename = fs::path(srcdir) / "main.cpp";
-                    } else if (thislang == "asm") {
-                        srcfilename = fs::path(srcdir) / "main.asm";
-                    }
-                    srcfile.open(srcfilename);
-                    if (srcfile) {
-                        checkRules(line);
-                        emit(srcfile, line);
-                        srcnames.emplace(srcfilename.filename());
-                        inIndentedFile = true;
-                    }
+                    name = prevline;
+                } else if (firstFile) {  // un-named source file
+                    name = mainSourceName();
+                } else {
+                    break;
                 }
-            } else {
-                if (!isEmptyOrUnderline(line)) {
-                    checkLanguageTags(line);
-                    std::swap(prevline, line);
+                if (startFile(name)) {
+                    checkRules(line.text);
+                    emit(srctext, line);
+                    state = State::indented;
                 }
+                break;
             }
+            case Action::emit:
+                checkRules(line.text);
+                emit(srctext, line);
+                break;
+            case Action::write:
+                checkRules(line.text);
+                write(srctext, line);
+                break;
+            case Action::close:
+                prevline = line.text;
+                finishFile();
+                state = State::prose;
+                break;
         }
     }
-    in.close();
+    finishFile();
     if (!srcnames.empty()) {
         writeSrcLevel();
         copyCloneDir(overwrite);
         writeTopLevel();
+        writeBuildFiles();
+        writePresets();
+        takeBuildTree();
         // copy md file to projname/src
-        auto options = overwrite ? fs::copy_options::overwrite_existing : fs::copy_options::none;
-        fs::copy_file(mdfile, srcdir + "/" + projname + mdextension, options);
+        writeFile(srcdir + "/" + projname + mdextension, contents());
+        writeManifest(mdDigest);
     }
     return !srcnames.empty();
 }
 
+/*! write `data` to `filename`.
+ *
+ * In incremental mode a file that already holds exactly `data` is left
+ * alone, so that its modification time does not trigger a rebuild.
+ */
+bool AutoProject::writeFile(const fs::path& filename, std::string_view data) {
+    if (incremental && sameContents(filename, data)) {
+        ++unchanged;
+        outputs.push_back(filename);
+        return true;
+    }
+    std::ofstream out{filename, std::ios::binary};
+    out.write(data.data(), data.size());
+    if (!out) {
+        return false;
+    }
+    outputs.push_back(filename);
+    return true;
+}
+
+/*! The manifest is a line of `manifestTag` followed by lines of the form
+ * `<kind> <value>` or `<kind> <value> <path>`:
+ *
+ *     version <autoproject version>
+ *     config <digest of the language configuration>
+ *     md <digest of the md contents>
+ *     language <language of the sources>
+ *     input <digest> <path of a rules, template or cloned file>
+ *     toolchain <digest> <language whose compiler and linker were used>
+ *     output <digest> <path of an output file relative to outdir>
+ *     source <name of an extracted source file>
+ *     end
+ *
+ * Only a manifest that is complete and matches in every respect makes
+ * the project up to date.
+ */
+bool AutoProject::readManifest(std::string_view mdDigest) {
+    std::ifstream in{outdir / manifestName, std::ios::binary};
+    std::string line;
+    if (!std::getline(in, line) || line != manifestTag) {
+        return false;
+    }
+    const std::map<std::string_view, std::string> expected{
+        { "version", VERSION },
+        { "config", configDigest() },
+        { "md", std::string{mdDigest} },
+    };
+    std::size_t matched{0};
+    std::size_t outputCount{0};
+    std::vector<fs::path> sources;
+    std::string language;
+    while (std::getline(in, line)) {
+        std::string_view rest{line};
+        auto word = [&rest]{
+            const auto end{std::min(rest.find(' '), rest.size())};
+            const auto first{rest.substr(0, end)};
+            rest.remove_prefix(std::min(end + 1, rest.size()));
+            return first;
+        };
+        const auto kind{word()};
+        if (kind == "end") {
+            if (matched != expected.size() || sources.empty()) {
+                return false;
+            }
+            srcnames = std::move(sources);
+            thislang = std::move(language);
+            unchanged = outputCount;
+            current = true;
+            return true;
+        } else if (auto it{expected.find(kind)}; it != expected.end()) {
+            if (rest != it->second) {
+                return false;
+            }
+            ++matched;
+        } else if (kind == "language") {
+            language = rest;
+        } else if (kind == "input") {
+            const auto digest{word()};
+            if (fileDigest(std::string{rest}) != digest) {
+                return false;
+            }
+        } else if (kind == "toolchain") {
+            const auto digest{word()};
+            if (toolchainDigest(std::string{rest}) != digest) {
+                return false;
+            }
+        } else if (kind == "output") {
+            const auto digest{word()};
+            if (contentDigest(outdir / std::string{rest}) != digest) {
+                return false;
+            }
+            ++outputCount;
+        } else if (kind == "source") {
+            sources.emplace_back(std::string{rest});
+        } else {
+            return false;
+        }
+    }
+    return false;
+}
+
+void AutoProject::writeManifest(std::string_view mdDigest) const {
+    std::ofstream out{outdir / manifestName, std::ios::binary};
+    out << manifestTag << '\n'
+        << "version " << VERSION << '\n'
+        << "config " << configDigest() << '\n'
+        << "md " << mdDigest << '\n'
+        << "language " << thislang << '\n';
+    for (const auto& input : inputFiles()) {
+        out << "input " << fileDigest(input) << ' ' << input.string() << '\n';
+    }
+    if (const auto digest{toolchainDigest(thislang)}; !digest.empty()) {
+        out << "toolchain " << digest << ' ' << thislang << '\n';
+    }
+    for (const auto& output : outputs) {
+        out << "output " << contentDigest(output) << ' ' << output.lexically_relative(outdir).string() << '\n';
+    }
+    for (const auto& name : srcnames) {
+        out << "source " << name.string() << '\n';
+    }
+    out << "end\n";
+}
+
+std::vector<fs::path> AutoProject::inputFiles() const {
+    std::vector<fs::path> inputs;
+    if (const auto config{lang.find(thislang)}; config != lang.end()) {
+        inputs.push_back(config->second.rulesfilename);
+    }
+    inputs.push_back(toplevelfilename);
+    inputs.push_back(srclevelfilename);
+    // if it is removed from the cache, the project must be made again to build it anew
+    if (!sharedHeader.empty()) {
+        inputs.push_back(sharedHeader);
+    }
+    if (!initialCache.empty()) {
+        inputs.push_back(initialCache);
+    }
+    if (!clonedir.empty()) {
+        const auto first{inputs.size()};
+        for (const auto& entry : fs::recursive_directory_iterator(configdir / clonedir)) {
+            if (fs::is_regular_file(entry.status())) {
+                inputs.push_back(entry.path());
+            }
+        }
+        // directory order varies, but the manifest should not
+        std::sort(inputs.begin() + first, inputs.end());
+    }
+    return inputs;
+}
+
+/// digest of every language's configuration, which decides the inputs for a given md file
+std::string AutoProject::configDigest() const {
+    std::uint64_t hash{fnv1a("")};
+    for (const auto& [name, config] : lang) {
+        for (const auto& piece : { fs::path{name}, config.configdir, config.rulesfilename,
+                config.toplevelcmakefilename, config.srclevelcmakefilename, config.clonedir,
+                fs::path{config.compiler}, fs::path{config.compileflags}, fs::path{config.linker},
+                fs::path{config.sharedheaders} }) {
+            hash = fnv1a("\n", fnv1a(piece.string(), hash));
+        }
+        hash = fnv1a(std::to_string(static_cast<int>(config.generator)) + (config.unity ? "u" : "") + std::string{nameOf(config.profile)}, hash);
+        // only mixed in when set, so that the digests of existing projects stay the same
+        if (!config.objectcache.empty()) {
+            hash = fnv1a(config.objectcache.string(), fnv1a("\nobjectcache ", hash));
+        }
+        if (!config.unityskip.empty()) {
+            hash = fnv1a(config.unityskip, fnv1a("\nunityskip ", hash));
+        }
+        if (!config.initialcache) {
+            hash = fnv1a("\nno initial cache", hash);
+        }
+    }
+    return hexDigest(hash);
+}
+
+std::string AutoProject::toolchainDigest(const std::string& name) const {
+    const auto config{lang.find(name)};
+    if (config == lang.end() || config->second.compiler.empty()) {
+        return {};
+    }
+    const auto& settings{config->second};
+    const auto compiler{Tool::shared(settings.compiler, settings.cachedir)};
+    const auto linker{Tool::shared(settings.linker.empty() ? settings.compiler : settings.linker, settings.cachedir)};
+    // a missing program never matches, so the project is made again and the error reported
+    if (!compiler || !linker) {
+        return "-";
+    }
+    return hexDigest(fnv1a(linker->digest(), fnv1a(compiler->digest())));
+}
+
 void AutoProject::makeTree(bool overwrite) {
-    fs::path builddir{outdir.string() + "/build"};
+    const auto builddir{outdir / buildDir()};
     if (overwrite) {
         fs::create_directories(srcdir);
         fs::create_directories(builddir);
@@ -201,240 +509,899 @@ void AutoProject::makeTree(bool overwrite) {
     }
 }
 
-void AutoProject::writeSrcLevel() const {
-    static const std::regex projname_regex{"[{]projname[}]"};
-    static const std::regex extras_regex{"[{]extras[}]"};
-    static const std::regex srcnames_regex{"[{]srcnames[}]"};
-    static const std::regex libraries_regex{"[{]libraries[}]"};
-    std::ifstream in{srclevelfilename};
-    if (!in) {
-        std::cerr << "Error: cannot open source level filename \"" << srclevelfilename << "\"\n";
-        exit(1);
+fs::path AutoProject::buildDir() const {
+    const auto config{lang.find(thislang)};
+    if (config == lang.end() || config->second.profile == Profile::none || thislang == "asm") {
+        return "build";
+    }
+    return "build-" + std::string{nameOf(config->second.profile)};
+}
+
+void AutoProject::writeSrcLevel() {
+    const auto tmpl{Template::shared(srclevelfilename)};
+    if (!tmpl) {
+        throw std::runtime_error("cannot open source level filename \"" + srclevelfilename.string() + "\"");
     }
+    // several rules may share the same extras or libraries; each is written once
+    std::unordered_set<std::string_view> seenExtras;
+    std::unordered_set<std::string_view> seenLibs;
     std::stringstream extras;
-    for (const auto &rule : extraRules) {
-        extras << rule << '\n';
+    std::stringstream libs;
+    for (const auto id : triggered) {
+        const auto& rule{(*rules)[id]};
+        if (seenExtras.insert(rule.cmake).second) {
+            extras << rule.cmake << '\n';
+        }
+        if (seenLibs.insert(rule.libraries).second) {
+            libs << ' ' << rule.libraries;
+        }
     }
+    std::vector<fs::path> shared;
+    const auto progs{programs(shared)};
     std::stringstream sources;
+    std::size_t unitySources{0};
+    if (const auto config{lang.find(thislang)}; config != lang.end() && config->second.unity) {
+        // a type defined by two sources would be defined twice once they are combined
+        for (const auto& [type, definers] : typeDefiners) {
+            if (definers.size() > 1) {
+                unityExcluded.insert(unityExcluded.end(), definers.begin(), definers.end());
+            }
+        }
+        std::istringstream skip{config->second.unityskip};
+        for (std::string name; skip >> name; ) {
+            unityExcluded.push_back(name);
+        }
+        // each excluded source once, in the order of the sources
+        std::vector<fs::path> excluded;
+        for (const auto& fn : srcnames) {
+            if (std::find(unityExcluded.begin(), unityExcluded.end(), fn) != unityExcluded.end()) {
+                excluded.push_back(fn);
+            }
+        }
+        unityExcluded = std::move(excluded);
+    }
     for (const auto& fn : srcnames) {
+        // the first program gets the headers, as the only program always has
+        if (!progs.empty() && !isHeaderExtension(fn.extension().string())
+                && std::find(progs.front().sources.begin(), progs.front().sources.end(), fn) == progs.front().sources.end()) {
+            continue;
+        }
         sources << ' ' << fn;
+        if (!isHeaderExtension(fn.extension().string())
+                && std::find(unityExcluded.begin(), unityExcluded.end(), fn) == unityExcluded.end()) {
+            ++unitySources;
+        }
     }
-    std::stringstream libs;
-    for (const auto &lib : libraries) {
-        libs << ' ' << lib;
+    if (const auto config{lang.find(thislang)}; config != lang.end() && thislang != "asm") {
+        extras << profileCommands(config->second.profile);
     }
+    // a unity build only saves anything if it has at least two sources to combine
+    if (const auto config{lang.find(thislang)}; config != lang.end() && config->second.unity
+            && thislang != "asm" && unitySources > 1) {
+        extras << "set(CMAKE_UNITY_BUILD ON)\n";
+        if (!unityExcluded.empty()) {
+            extras << "set_source_files_properties(";
+            for (const auto& fn : unityExcluded) {
+                extras << fn << ' ';
+            }
+            extras << "PROPERTIES SKIP_UNITY_BUILD_INCLUSION ON)\n";
+        }
+    }
+    const auto extrasText{extras.str()};
+    const auto sourcesText{sources.str()};
+    const auto libsText{libs.str()};
+    const auto precompiledText{precompiledHeaders()};
+    const auto programsText{progs.empty() ? std::string{} : programTargets(progs, shared, libsText)};
     // write CMakeLists.txt with filenames to projname/src
-    std::ofstream srccmake(srcdir + "/CMakeLists.txt");
-    std::string line;
-    while (std::getline(in, line)) {
-        line = std::regex_replace(line, projname_regex, projname);
-        line = std::regex_replace(line, srcnames_regex, sources.str());
-        line = std::regex_replace(line, extras_regex, extras.str());
-        line = std::regex_replace(line, libraries_regex, libs.str());
-        srccmake << line << '\n';
+    writeFile(srcdir + "/CMakeLists.txt", tmpl->render({projname, sourcesText, extrasText, libsText, precompiledText, programsText}));
+}
+
+/*! Each program needs its entry point and whatever the include graph
+ * leads to from there, where including a header also brings in the
+ * source of the same name, so `list.h` leads to `list.cpp`.  A source
+ * that more than one program needs is compiled once, into an object
+ * library they all link, and so is one that the include graph does not
+ * reach at all, since any of them might need it.
+ */
+std::vector<AutoProject::Program> AutoProject::programs(std::vector<fs::path>& shared) const {
+    std::vector<Program> progs;
+    shared.clear();
+    if (entryPoints.size() < 2 || thislang == "asm") {
+        return progs;
+    }
+    auto compiled = [](const fs::path& fn){ return !isHeaderExtension(fn.extension().string()); };
+    auto isEntryPoint = [this](const fs::path& fn){ return std::find(entryPoints.begin(), entryPoints.end(), fn) != entryPoints.end(); };
+    // how many programs need each compiled source that is not an entry point
+    std::map<fs::path, std::size_t> users;
+    for (const auto& fn : srcnames) {
+        if (compiled(fn) && !isEntryPoint(fn)) {
+            users[fn] = 0;
+        }
+    }
+    std::vector<std::set<fs::path>> needs;
+    for (const auto& entry : entryPoints) {
+        std::set<fs::path> seen{entry};
+        std::vector<fs::path> todo{entry};
+        while (!todo.empty()) {
+            const auto file{todo.back()};
+            todo.pop_back();
+            std::vector<fs::path> next;
+            if (const auto edges{localIncludes.find(file)}; edges != localIncludes.end()) {
+                next = edges->second;
+            }
+            if (!compiled(file)) {
+                std::copy_if(srcnames.begin(), srcnames.end(), std::back_inserter(next),
+                    [&](const fs::path& fn){ return compiled(fn) && fn.stem() == file.stem(); });
+            }
+            for (const auto& fn : next) {
+                // only files of the post count, and another program's entry point is never part of this one
+                if (localIncludes.count(fn) && !isEntryPoint(fn) && seen.insert(fn).second) {
+                    todo.push_back(fn);
+                }
+            }
+        }
+        for (auto& [fn, count] : users) {
+            count += seen.count(fn);
+        }
+        needs.push_back(std::move(seen));
+    }
+    for (const auto& fn : srcnames) {
+        if (const auto it{users.find(fn)}; it != users.end() && it->second != 1) {
+            shared.push_back(fn);
+        }
     }
+    for (std::size_t i{0}; i < entryPoints.size(); ++i) {
+        Program program{i == 0 ? projname : projname + "_" + entryPoints[i].stem().string(), {}};
+        for (const auto& fn : srcnames) {
+            const auto it{users.find(fn)};
+            if (fn == entryPoints[i] || (it != users.end() && it->second == 1 && needs[i].count(fn))) {
+                program.sources.push_back(fn);
+            }
+        }
+        progs.push_back(std::move(program));
+    }
+    return progs;
 }
 
-void AutoProject::copyCloneDir(bool overwrite) const {
-    if (!clonedir.empty()) {
+/*! The template builds the first program, named for the project, and
+ * these commands add the rest.  The other targets get the same compile
+ * features as the first, whatever the template gave it, and the same
+ * libraries.
+ */
+std::string AutoProject::programTargets(const std::vector<Program>& progs, const std::vector<fs::path>& shared, const std::string& libraries) const {
+    std::ostringstream out;
+    std::vector<std::string> targets;
+    std::string sharedLibrary;
+    if (!shared.empty()) {
+        sharedLibrary = projname + "_shared";
+        out << "add_library(" << sharedLibrary << " OBJECT";
+        for (const auto& fn : shared) {
+            out << ' ' << fn;
+        }
+        out << ")\n";
+        if (libraries.find_first_not_of(' ') != std::string::npos) {
+            out << "target_link_libraries(" << sharedLibrary << libraries << ")\n";
+        }
+        out << "target_link_libraries(" << projname << ' ' << sharedLibrary << ")\n";
+        targets.push_back(sharedLibrary);
+    }
+    for (auto program{std::next(progs.begin())}; program != progs.end(); ++program) {
+        out << "add_executable(" << program->name;
+        for (const auto& fn : program->sources) {
+            out << ' ' << fn;
+        }
+        out << ")\n"
+            << "target_link_libraries(" << program->name << (sharedLibrary.empty() ? "" : " ") << sharedLibrary << libraries << ")\n";
+        targets.push_back(program->name);
+    }
+    out << "get_target_property(features " << projname << " COMPILE_FEATURES)\n"
+        << "if (features)\n"
+        << "    foreach(target";
+    for (const auto& target : targets) {
+        out << ' ' << target;
+    }
+    out << ")\n"
+        << "        target_compile_features(${target} PRIVATE ${features})\n"
+        << "    endforeach()\n"
+        << "endif()\n";
+    return out.str();
+}
+
+/*! A precompiled header saves each source from parsing the same system
+ * headers again, but building it costs about as much as compiling one
+ * source, so it is only used for projects of at least `pchMinSources`
+ * sources, and then only for the headers that several of them share.
+ * The header is included ahead of every source, so all of them must be
+ * in the same language, and a source that defines macros before its
+ * includes is left to compile without it.
+ */
+std::string AutoProject::precompiledHeaders() const {
+    std::vector<const fs::path*> compiled;
+    for (const auto& fn : srcnames) {
+        if (!isHeaderExtension(fn.extension().string())) {
+            compiled.push_back(&fn);
+        }
+    }
+    if (thislang == "asm" || compiled.size() < pchMinSources || std::any_of(compiled.begin(), compiled.end(),
+            [&](const fs::path* fn){ return fn->extension() != compiled.front()->extension(); })) {
+        return {};
+    }
+    std::string headers;
+    for (const auto& [header, count] : systemHeaders) {
+        if (count >= pchMinIncluders) {
+            headers += ' ' + header;
+        }
+    }
+    if (headers.empty()) {
+        return {};
+    }
+    std::ostringstream out;
+    out << "target_precompile_headers(" << projname << " PRIVATE" << headers << ")\n";
+    if (!pchExcluded.empty()) {
+        out << "set_source_files_properties(";
+        for (const auto& fn : pchExcluded) {
+            out << fn << ' ';
+        }
+        out << "PROPERTIES SKIP_PRECOMPILE_HEADERS ON)\n";
+    }
+    return out.str();
+}
+
+/*! Write a compile_commands.json, so that clangd and clang-tidy can
+ * work on the project at once, and with the ninja or make generator also
+ * a build file that builds it directly.  Both use the configured
+ * compiler and linker and the flags of the triggered rules; without a
+ * configured compiler, the database names the usual `cc` or `c++`.  The
+ * build file also includes the shared precompiled header, if one is
+ * configured.
+ */
+void AutoProject::writeBuildFiles() {
+    const auto config{lang.find(thislang)};
+    if (config == lang.end()) {
+        return;
+    }
+    const auto& settings{config->second};
+    const bool direct{settings.generator != Generator::cmake};
+    auto compilername{settings.compiler};
+    if (compilername.empty()) {
+        if (direct) {
+            throw std::runtime_error("no Compiler is configured for " + thislang);
+        }
+        if (thislang != "c++" && thislang != "c") {
+            return;
+        }
+        compilername = thislang == "c++" ? "c++" : "cc";
+    }
+    const auto& linkername{settings.linker.empty() ? compilername : settings.linker};
+    const auto compiler{Tool::shared(compilername, settings.cachedir)};
+    if (direct && !compiler) {
+        throw std::runtime_error("cannot find the compiler " + compilername);
+    }
+    const auto linker{Tool::shared(linkername, settings.cachedir)};
+    if (direct && !linker) {
+        throw std::runtime_error("cannot find the linker " + linkername);
+    }
+    BuildSpec spec;
+    spec.target = projname;
+    // the build file builds only the first program, but the compilation database covers every source
+    std::vector<fs::path> shared;
+    const auto progs{programs(shared)};
+    std::vector<fs::path> allSources;
+    for (const auto& name : srcnames) {
+        if (!isHeaderExtension(name.extension().string())) {
+            allSources.push_back("src" / name);
+            if (progs.empty() || std::find(shared.begin(), shared.end(), name) != shared.end()
+                    || std::find(progs.front().sources.begin(), progs.front().sources.end(), name) != progs.front().sources.end()) {
+                spec.sources.push_back("src" / name);
+            }
+        }
+    }
+    // the compilation database still names a program that is not installed here
+    spec.compiler = compiler ? compiler->path : fs::path{compilername};
+    spec.compilerVersion = compiler ? compiler->version : std::string{};
+    spec.compileFlags = settings.compileflags;
+    spec.buildDir = buildDir();
+    spec.linker = linker ? linker->path : fs::path{linkername};
+    std::unordered_set<std::string_view> seenFlags;
+    for (const auto id : triggered) {
+        const auto& flags{(*rules)[id].flags};
+        if (!flags.empty() && seenFlags.insert(flags).second) {
+            addRuleFlags(spec, flags);
+        }
+    }
+    spec.gccStyle = thislang != "asm";
+    if (const auto flags{spec.gccStyle ? profileFlags(settings.profile) : std::string{}}; !flags.empty()) {
+        spec.compileFlags += (spec.compileFlags.empty() ? "" : " ") + flags;
+        if (settings.profile == Profile::lto) {
+            spec.linkFlags += (spec.linkFlags.empty() ? "" : " ") + "-flto"s;
+        }
+    }
+    if (direct && spec.gccStyle && compiler && !settings.sharedheaders.empty()) {
+        // if it cannot be built, the sources are simply compiled without it
+        if (const auto shared{SharedHeader::shared(*compiler, spec.compileFlags, settings.sharedheaders, thislang == "c++", settings.cachedir)}) {
+            sharedHeader = spec.sharedHeader = shared->header;
+        }
+        // as with the project's own precompiled header, a source that defines a macro first needs its headers without it
+        for (const auto& name : pchExcluded) {
+            spec.unshared.push_back("src" / name);
+        }
+    }
+    for (const auto& arg : launcherCommand(settings)) {
+        spec.launcher += (spec.launcher.empty() ? "" : " ") + shellQuoted(arg);
+    }
+    auto everything{spec};
+    everything.sources = std::move(allSources);
+    writeFile(outdir / "compile_commands.json", compilationDatabase(everything, fs::absolute(outdir).lexically_normal()));
+    if (settings.generator == Generator::ninja) {
+        writeFile(outdir / "build.ninja", ninjaFile(spec));
+    } else if (settings.generator == Generator::make) {
+        writeFile(outdir / "Makefile", makeFile(spec));
+    }
+}
+
+/*! The initial cache is made once per toolchain, with every package
+ * that any rule of the language finds, so the same file serves every
+ * project.  Configuring with `cmake --preset autoproject` includes it
+ * ahead of project(), which has the same effect as `cmake -C`, and runs
+ * each compile through the object cache if there is one.
+ */
+void AutoProject::writePresets() {
+    const auto config{lang.find(thislang)};
+    if (config == lang.end() || thislang == "asm" || !rules) {
+        return;
+    }
+    std::vector<std::pair<std::string, std::string>> variables;
+    if (const auto cache{config->second.initialcache
+            ? InitialCache::shared(packageCommands(*rules), config->second.cachedir, config->second.rebuildRuleCache) : nullptr}) {
+        initialCache = cache->file;
+        variables.emplace_back("CMAKE_PROJECT_INCLUDE_BEFORE", initialCache.generic_string());
+    }
+    std::string launcher;
+    for (const auto& arg : launcherCommand(config->second)) {
+        launcher += (launcher.empty() ? "" : ";") + fs::path{arg}.generic_string();
+    }
+    if (!launcher.empty()) {
+        variables.emplace_back("CMAKE_C_COMPILER_LAUNCHER", launcher);
+        variables.emplace_back("CMAKE_CXX_COMPILER_LAUNCHER", launcher);
+    }
+    if (variables.empty()) {
+        return;
+    }
+    std::string cacheVariables;
+    for (const auto& [name, value] : variables) {
+        cacheVariables += (cacheVariables.empty() ? "" : ",\n") + "        \""s + name + "\": " + Json{value}.dump();
+    }
+    writeFile(outdir / "CMakePresets.json",
+        "{\n"
+        "  \"version\": 3,\n"
+        "  \"cmakeMinimumRequired\": { \"major\": 3, \"minor\": 21, \"patch\": 0 },\n"
+        "  \"configurePresets\": [\n"
+        "    {\n"
+        "      \"name\": \"autoproject\",\n"
+        "      \"displayName\": \"Configure with the toolchain autoproject has already probed\",\n"
+        "      \"binaryDir\": " + Json{"${sourceDir}/" + buildDir().generic_string()}.dump() + ",\n"
+        "      \"cacheVariables\": {\n"
+        + cacheVariables + "\n"
+        "      }\n"
+        "    }\n"
+        "  ]\n"
+        "}\n");
+}
+
+/*! The trees of the pool are configured from the same packages as the
+ * initial cache, along with the commands of the optimization profile,
+ * so there is a pool for each language and profile.  Whether or not it
+ * had a tree to give, the pool is then refilled for the next project.
+ */
+void AutoProject::takeBuildTree() {
+    warmBuild = false;
+    const auto config{lang.find(thislang)};
+    if (config == lang.end() || thislang == "asm" || !rules || config->second.buildpool == 0) {
+        return;
+    }
+    const BuildPool pool{InitialCache::probeCommands(packageCommands(*rules)) + profileCommands(config->second.profile),
+        config->second.cachedir, config->second.buildpool};
+    const auto builddir{outdir / buildDir()};
+    std::error_code ec;
+    if (!fs::exists(builddir / "CMakeCache.txt", ec)) {
+        warmBuild = pool.take(builddir);
+    }
+    pool.refill();
+}
+
+void AutoProject::copyCloneDir(bool overwrite) {
+    if (clonedir.empty()) {
+        return;
+    }
+    const auto from{configdir / clonedir};
+    const auto to{outdir.string() / clonedir};
+    if (!incremental) {
         auto options = overwrite ? fs::copy_options::overwrite_existing|fs::copy_options::recursive : fs::copy_options::recursive;
-        fs::copy(configdir / clonedir, outdir.string() / clonedir, options);
+        fs::copy(from, to, options);
+    }
+    fs::create_directories(to);
+    for (const auto& entry : fs::recursive_directory_iterator(from)) {
+        const auto target{to / fs::relative(entry.path(), from)};
+        if (fs::is_directory(entry.status())) {
+            fs::create_directories(target);
+        } else if (fs::is_regular_file(entry.status())) {
+            if (incremental) {
+                MappedFile source{entry.path()};
+                writeFile(target, source.view());
+            } else {
+                outputs.push_back(target);
+            }
+        }
     }
 }
 
-void AutoProject::writeTopLevel() const {
-    static const std::regex projname_regex{"[{]projname[}]"};
-    std::ifstream in{toplevelfilename};
-    if (!in) {
-        std::cerr << "Error: cannot open top level filename \"" << toplevelfilename << "\"\n";
-        exit(1);
+void AutoProject::writeTopLevel() {
+    const auto tmpl{Template::shared(toplevelfilename)};
+    if (!tmpl) {
+        throw std::runtime_error("cannot open top level filename \"" + toplevelfilename.string() + "\"");
     }
-    std::ofstream topcmake{outdir.string() + "/CMakeLists.txt"};
-    std::string line;
-    while (std::getline(in, line)) {
-        topcmake << std::regex_replace(line, projname_regex, projname) << '\n';
+    writeFile(outdir.string() + "/CMakeLists.txt", tmpl->render({projname, {}, {}, {}}));
+}
+
+void AutoProject::checkRules(std::string_view line) {
+    checkStructure(line);
+    if (!rules) {
+        return;
+    }
+    for (const auto id : rules->match(line)) {
+        triggered.insert(id);
     }
 }
 
-void AutoProject::checkRules(const std::string &line) {
-    std::smatch sm;
-    for (const auto &rule : rules) {
-        if (std::regex_search(line, sm, rule.re)) {
-            extraRules.emplace(rule.cmake);
-            libraries.emplace(rule.libraries);
+/*! Only unconditional includes of system headers are candidates for the
+ * precompiled header; one that depends on an #if may be wanted on some
+ * platforms but not others.  Any include of another file in the post,
+ * though, is part of the include graph.
+ */
+void AutoProject::checkStructure(std::string_view line) {
+    static constexpr std::string_view entryPoint[]{"int main(", "int main (", "auto main(", "void main(", "main("};
+    const auto start{line.find_first_not_of(" \t")};
+    if (start == std::string_view::npos) {
+        return;
+    }
+    // cheap test first: nearly every line is rejected here
+    if (line[start] != '#') {
+        if (!scan.main && (line[start] == 'i' || line[start] == 'a' || line[start] == 'v' || line[start] == 'm')) {
+            scan.main = std::any_of(std::begin(entryPoint), std::end(entryPoint),
+                [&](std::string_view prefix){ return line.substr(start, prefix.size()) == prefix; });
+        }
+        return;
+    }
+    line = trim(line.substr(start + 1), ' ');
+    const auto directive{line.substr(0, line.find_first_of(" \t<\"("))};
+    if (directive == "if" || directive == "ifdef" || directive == "ifndef") {
+        ++scan.conditionals;
+    } else if (directive == "endif" && scan.conditionals > 0) {
+        --scan.conditionals;
+    } else if (directive == "define" || directive == "undef") {
+        scan.defines = true;
+    } else if (directive == "include") {
+        line = trim(line.substr(directive.size()), ' ');
+        if (line.size() > 1 && line.front() == '"') {
+            // the post's files all end up in one directory, so only the file name matters
+            scan.locals.push_back(fs::path{std::string{line.substr(1, line.find('"', 1) - 1)}}.filename());
+        } else if (const auto close{line.find('>')}; scan.conditionals == 0 && !line.empty() && line.front() == '<'
+                && close != std::string_view::npos) {
+            scan.headers.emplace(line.substr(0, close + 1));
+            scan.definesFirst = scan.definesFirst || scan.defines;
         }
     }
 }
 
-void AutoProject::checkLanguageTags(const std::string& line) {
-    if (!thislang.empty()) 
+void AutoProject::checkLanguageTags(std::string_view line) {
+    static constexpr std::string_view tagprefix{"### tags: "};
+    // cheap test first: nearly every line is rejected here
+    if (!thislang.empty() || line.substr(0, tagprefix.size()) != tagprefix) 
         return;
     static const std::regex tagcpp{"### tags: \\[.*'c\\+\\+'.*\\]"}; 
     static const std::regex tagc{"### tags: \\[.*'c'.*\\]"}; 
     static const std::regex tagasm{"### tags: \\[.*'assembly'.*\\]"}; 
-    std::smatch pieces;
-    if (std::regex_match(line, pieces, tagcpp)) {
+    if (std::regex_match(line.begin(), line.end(), tagcpp)) {
         thislang = "c++";
-    } else if (std::regex_match(line, pieces, tagc)) {
+    } else if (std::regex_match(line.begin(), line.end(), tagc)) {
         thislang = "c";
-    } else if (std::regex_match(line, pieces, tagasm)) {
+    } else if (std::regex_match(line.begin(), line.end(), tagasm)) {
         thislang = "asm";
     } else {
         return;
     }
-    rules = loadrules(lang[thislang].rulesfilename);
-    configdir = lang[thislang].configdir;
-    toplevelfilename = lang[thislang].toplevelcmakefilename;
-    srclevelfilename = lang[thislang].srclevelcmakefilename;
-    clonedir = lang[thislang].clonedir;
+    const auto& config{lang[thislang]};
+    rules = RuleSet::shared(config.rulesfilename, config.cachedir, config.rebuildRuleCache);
+    configdir = config.configdir;
+    toplevelfilename = config.toplevelcmakefilename;
+    srclevelfilename = config.srclevelcmakefilename;
+    clonedir = config.clonedir;
 }
 
 std::ostream& operator<<(std::ostream& out, const AutoProject &ap) {
+    if (ap.current) {
+        return out << ap.outdir << " is up to date\n";
+    }
     out << "Successfully extracted the following source files to " << ap.outdir << ":\n";
     std::copy(ap.srcnames.begin(), ap.srcnames.end(), std::ostream_iterator<fs::path>(out, "\n"));
+    if (ap.incremental) {
+        out << ap.unchanged << " unchanged files were left as they were\n";
+    }
+    if (ap.warmBuild) {
+        out << "The build directory was configured ahead of time\n";
+    }
     return out;
 }
 
 // helper functions
 
+/// the name of `profile` as it is given on the command line, or an empty string for none
+std::string_view nameOf(Profile profile) {
+    static constexpr std::string_view names[]{"", "debug", "release", "native", "lto"};
+    return names[static_cast<std::size_t>(profile)];
+}
+
+/*! The CMake commands for `profile`.
+ *
+ * The profile is only the default of the AUTOPROJECT_PROFILE cache
+ * variable, so a build directory keeps the profile it was first
+ * configured with, and it is written to profile.txt there to say which
+ * profile built the binaries beside it.  A build configured with the
+ * profile "none" gets no flags from it at all.  The AUTOPROJECT_PGO cache
+ * variable adds the flags of either stage of a profile-guided build.
+ */
+std::string profileCommands(Profile profile) {
+    if (profile == Profile::none) {
+        return {};
+    }
+    // the two stages of autoproject --pgo; Clang's raw profiles must be merged before they can be used
+    static const std::string pgoCommands{
+        "set(AUTOPROJECT_PGO \"\" CACHE STRING \"Profile-guided optimization stage: generate, use or empty for none\")\n"
+        "set(AUTOPROJECT_PGO_DIR ${CMAKE_BINARY_DIR}/pgo CACHE PATH \"Where the training run writes its profile\")\n"
+        "if (AUTOPROJECT_PGO AND NOT MSVC)\n"
+        "    if (CMAKE_C_COMPILER_ID MATCHES \"Clang\" OR CMAKE_CXX_COMPILER_ID MATCHES \"Clang\")\n"
+        "        if (AUTOPROJECT_PGO STREQUAL \"use\")\n"
+        "            find_program(LLVM_PROFDATA llvm-profdata)\n"
+        "            file(GLOB rawprofiles ${AUTOPROJECT_PGO_DIR}/*.profraw)\n"
+        "            execute_process(COMMAND ${LLVM_PROFDATA} merge -output=${AUTOPROJECT_PGO_DIR}/merged.profdata ${rawprofiles})\n"
+        "            add_compile_options(-fprofile-use=${AUTOPROJECT_PGO_DIR}/merged.profdata)\n"
+        "        else()\n"
+        "            add_compile_options(-fprofile-generate=${AUTOPROJECT_PGO_DIR})\n"
+        "            add_link_options(-fprofile-generate=${AUTOPROJECT_PGO_DIR})\n"
+        "        endif()\n"
+        "    elseif (AUTOPROJECT_PGO STREQUAL \"use\")\n"
+        "        add_compile_options(-fprofile-use=${AUTOPROJECT_PGO_DIR} -Wno-missing-profile)\n"
+        "    else()\n"
+        "        add_compile_options(-fprofile-generate=${AUTOPROJECT_PGO_DIR})\n"
+        "        add_link_options(-fprofile-generate=${AUTOPROJECT_PGO_DIR})\n"
+        "    endif()\n"
+        "endif()\n"
+    };
+    return "set(AUTOPROJECT_PROFILE " + std::string{nameOf(profile)} + " CACHE STRING \"Optimization profile: debug, release, native, lto or none\")\n"
+        "message(STATUS \"Optimization profile: ${AUTOPROJECT_PROFILE}\")\n"
+        "file(WRITE ${CMAKE_BINARY_DIR}/profile.txt \"${AUTOPROJECT_PROFILE}\\n\")\n"
+        "if (AUTOPROJECT_PROFILE STREQUAL \"none\")\n"
+        "    # only the build's own CMAKE_<LANG>_FLAGS, as in autoproject --matrix\n"
+        "elseif (AUTOPROJECT_PROFILE STREQUAL \"debug\")\n"
+        "    if (MSVC)\n"
+        "        add_compile_options(/Od /Zi)\n"
+        "    else()\n"
+        "        add_compile_options(-O0 -g)\n"
+        "    endif()\n"
+        "else()\n"
+        "    add_compile_definitions(NDEBUG)\n"
+        "    if (MSVC)\n"
+        "        add_compile_options(/O2)\n"
+        "    elseif (AUTOPROJECT_PROFILE STREQUAL \"native\")\n"
+        "        add_compile_options(-O3 -march=native)\n"
+        "    else()\n"
+        "        add_compile_options(-O2)\n"
+        "    endif()\n"
+        "    if (AUTOPROJECT_PROFILE STREQUAL \"lto\")\n"
+        "        include(CheckIPOSupported)\n"
+        "        check_ipo_supported(RESULT ipo)\n"
+        "        set(CMAKE_INTERPROCEDURAL_OPTIMIZATION ${ipo})\n"
+        "    endif()\n"
+        "endif()\n"
+        + pgoCommands;
+}
+
+/// the compile flags of `profile` for the ninja and make generators, which only drive GCC style compilers
+std::string profileFlags(Profile profile) {
+    switch (profile) {
+        case Profile::debug:
+            return "-O0 -g";
+        case Profile::release:
+            return "-O2 -DNDEBUG";
+        case Profile::native:
+            return "-O3 -march=native -DNDEBUG";
+        case Profile::lto:
+            return "-O2 -flto -DNDEBUG";
+        default:
+            return {};
+    }
+}
+
+/// the find_package commands of every rule in `rules`, one per line, sorted and each only once
+std::string packageCommands(const RuleSet& rules) {
+    std::set<std::string> commands;
+    for (std::size_t id{0}; id < rules.size(); ++id) {
+        std::istringstream in{rules[id].cmake};
+        for (std::string line; std::getline(in, line); ) {
+            if (line.rfind("find_package(", 0) == 0) {
+                commands.insert(line);
+            }
+        }
+    }
+    std::string text;
+    for (const auto& command : commands) {
+        text += command + '\n';
+    }
+    return text;
+}
+
+/*! the command, as separate arguments, that runs a compile through the
+ * object cache of `config`, or nothing if it has none.
+ *
+ * The cache directory is made absolute, since CMake runs compiles from
+ * directories of its own.
+ */
+std::vector<std::string> launcherCommand(const LangConfig& config) {
+    if (config.objectcache.empty() || config.cachedir.empty()) {
+        return {};
+    }
+    return { config.objectcache.string(), "--object-cache", fs::absolute(config.cachedir).lexically_normal().string() };
+}
+
+/*! returns true if `text` is safe to compile in the same translation
+ * unit as other sources.
+ *
+ * Anything defined at file scope to be local to its source, such as a
+ * static function, an unnamed namespace, a macro or a const variable,
+ * may clash with a name in another source once they are compiled
+ * together, so sources with any such line starting in the first column
+ * are compiled on their own.  A const or constexpr line is only a
+ * variable if no parenthesis comes before its initializer, since
+ * constexpr functions are inline and so cannot clash.
+ */
+bool unitySafe(std::string_view text) {
+    static constexpr std::string_view fileLocal[]{"static ", "namespace {", "namespace{", "#define ", "using namespace "};
+    static constexpr std::string_view constant[]{"const ", "constexpr "};
+    for (std::string_view rest{text}; !rest.empty(); ) {
+        const Line line{nextLine(rest)};
+        if (line.tabs) {
+            continue;
+        }
+        for (const auto prefix : fileLocal) {
+            if (line.text.substr(0, prefix.size()) == prefix) {
+                return false;
+            }
+        }
+        for (const auto prefix : constant) {
+            if (line.text.substr(0, prefix.size()) == prefix) {
+                const auto end{line.text.find_first_of("(={;")};
+                if (end == std::string_view::npos || line.text[end] != '(') {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+/*! the names of the classes, structs, unions and enums that `text`
+ * defines at file scope, on lines starting in the first column.
+ *
+ * A line that ends its declaration with a semicolon and has no body,
+ * such as `struct stat info;` or a forward declaration, defines nothing.
+ */
+std::vector<std::string> definedTypes(std::string_view text) {
+    static constexpr std::string_view keywords[]{"class ", "struct ", "union ", "enum class ", "enum struct ", "enum "};
+    std::vector<std::string> names;
+    for (std::string_view rest{text}; !rest.empty(); ) {
+        const Line line{nextLine(rest)};
+        if (line.tabs) {
+            continue;
+        }
+        for (const auto keyword : keywords) {
+            if (line.text.substr(0, keyword.size()) != keyword) {
+                continue;
+            }
+            auto after{line.text.substr(keyword.size())};
+            after.remove_prefix(std::min(after.find_first_not_of(' '), after.size()));
+            const auto length{std::min(after.find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_"), after.size())};
+            const auto semicolon{after.find(';')};
+            if (length && (semicolon == std::string_view::npos || after.find('{') < semicolon)) {
+                names.emplace_back(after.substr(0, length));
+            }
+            break;
+        }
+    }
+    return names;
+}
+
+/*! the digest of the contents of `filename`, or an empty string if it
+ * cannot be read.
+ *
+ * The same rules and templates serve every project, so digests are
+ * remembered for as long as the file's size and modification time stay
+ * the same.
+ */
+std::string fileDigest(const fs::path& filename) {
+    struct Known {
+        std::uintmax_t size;
+        fs::file_time_type time;
+        std::string digest;
+    };
+    static std::mutex mtx;
+    static std::map<fs::path, Known> known;
+    std::error_code ec;
+    const auto size{fs::file_size(filename, ec)};
+    const auto time{ec ? fs::file_time_type{} : fs::last_write_time(filename, ec)};
+    if (ec) {
+        return {};
+    }
+    {
+        std::lock_guard<std::mutex> lock{mtx};
+        if (auto it{known.find(filename)}; it != known.end() && it->second.size == size && it->second.time == time) {
+            return it->second.digest;
+        }
+    }
+    auto digest{contentDigest(filename)};
+    if (digest.empty()) {
+        return {};
+    }
+    std::lock_guard<std::mutex> lock{mtx};
+    known[filename] = {size, time, digest};
+    return digest;
+}
+
+/*! the digest of the contents of `filename` as it is now, or an empty
+ * string if it cannot be read.
+ *
+ * Unlike fileDigest, nothing is remembered, so an edit that keeps the
+ * size of the file is always noticed.
+ */
+std::string contentDigest(const fs::path& filename) {
+    try {
+        return hexDigest(fnv1a(MappedFile{filename}.view()));
+    }
+    catch (std::exception&) {
+        return {};
+    }
+}
+
 /// returns true if passed file extension is an identified source code extension.
 bool isSourceExtension(const std::string_view ext) {
     static const std::unordered_set<std::string_view> source_extensions{".cpp", ".c", ".h", ".hpp", ".asm"};
     return source_extensions.find(ext) != source_extensions.end();
 }
 
-std::string& trim(std::string& str, const std::string_view pattern) {
-    // TODO: when we get C++20, use std::string::starts_with()
-    if (str.find(pattern) == 0) {
-        str.erase(0, pattern.size());
+/// returns true if passed file extension is that of a header, which is not compiled on its own.
+bool isHeaderExtension(const std::string_view ext) {
+    return ext == ".h" || ext == ".hpp";
+}
+
+std::string_view trim(std::string_view str, const std::string_view pattern) {
+    // TODO: when we get C++20, use std::string_view::starts_with()
+    if (str.substr(0, pattern.size()) == pattern) {
+        str.remove_prefix(pattern.size());
     }
     return str;
 }
 
-std::string& rtrim(std::string& str, const std::string_view pattern) {
-    // TODO: when we get C++20, use std::string::ends_with()
-    auto loc{str.rfind(pattern)};
-    if (loc != std::string::npos && loc == str.size() - pattern.size()) {
-        str.erase(str.size() - pattern.size(), pattern.size());
+std::string_view rtrim(std::string_view str, const std::string_view pattern) {
+    // TODO: when we get C++20, use std::string_view::ends_with()
+    if (str.size() >= pattern.size() && str.substr(str.size() - pattern.size()) == pattern) {
+        str.remove_suffix(pattern.size());
     }
     return str;
 }
 
-std::string& trim(std::string& str, char ch) {
-    auto it{str.begin()};
-    for ( ; (*it == ch || isspace(*it)) && it != str.end(); ++it)
-    { }
-    if (it != str.end()) {
-        str.erase(str.begin(), it);
+std::string_view trim(std::string_view str, char ch) {
+    while (!str.empty() && (str.front() == ch || isspace(static_cast<unsigned char>(str.front())))) {
+        str.remove_prefix(1);
     }
     return str;
 }
 
-std::string& rtrim(std::string& str, char ch) {
-    std::reverse(str.begin(), str.end());
-    trim(str, ch);
-    std::reverse(str.begin(), str.end());
+std::string_view rtrim(std::string_view str, char ch) {
+    while (!str.empty() && (str.back() == ch || isspace(static_cast<unsigned char>(str.back())))) {
+        str.remove_suffix(1);
+    }
     return str;
 }
 
-bool isSourceFilename(std::string &line) {
-    trimExtras(line);
+bool isSourceFilename(std::string_view &line) {
+    line = trimExtras(line);
     return isSourceExtension(fs::path(line).extension().string());
 }
 
-std::string trimExtras(std::string& line) {
-    if (line.empty()) {
-        return line;
-    }
+std::string_view trimExtras(std::string_view line) {
     // remove header markup
-    trim(line, '#');
-    rtrim(line, '#');
+    line = rtrim(trim(line, '#'), '#');
     // remove bold or italic
-    trim(line, '*');
-    rtrim(line, '*');
+    line = rtrim(trim(line, '*'), '*');
     // remove html bold
-    trim(line, "<b>");
-    rtrim(line, "</b>");
+    line = rtrim(trim(line, "<b>"), "</b>");
     // remove quotes
-    trim(line, '"');
-    rtrim(line, '"');
+    line = rtrim(trim(line, '"'), '"');
     // remove trailing - or :
-    rtrim(line, '-');
-    rtrim(line, ':');
-    return line;
+    return rtrim(rtrim(line, '-'), ':');
 }
 
-bool isNonEmptyIndented(const std::string& line) {
-    size_t indent{line.find_first_not_of(' ')};
-    return indent >= indentLevel && indent != std::string::npos;
-}
-
-bool isIndentedOrEmpty(const std::string& line) {
-    size_t indent{line.find_first_not_of(' ')};
-    return indent >= indentLevel;
+/// split the next line off the front of `input`, as getline would
+Line nextLine(std::string_view& input) {
+    auto eol{input.find('\n')};
+    Line line;
+    line.text = input.substr(0, eol);
+    input.remove_prefix(eol == std::string_view::npos ? input.size() : eol + 1);
+    if (!line.text.empty() && line.text.back() == '\r') {
+        line.text.remove_suffix(1);
+    }
+    while (line.tabs < line.text.size() && line.text[line.tabs] == '\t') {
+        ++line.tabs;
+    }
+    line.text.remove_prefix(line.tabs);
+    return line;
 }
 
-bool isEmptyOrUnderline(const std::string& line) {
-    size_t indent{line.find_first_not_of('-')};
-    return line.empty() || indent == std::string::npos;
+LineClass classify(const Line& line) {
+    const auto text{line.text};
+    // note that a line consisting only of delimiter characters counts, however short
+    if (!line.tabs && !text.empty() && (text[0] == '`' || text[0] == '~')
+            && text.find_first_not_of(text[0]) >= delimLength) {
+        return LineClass::fence;
+    }
+    const auto indent{line.indent()};
+    if (indent == std::string_view::npos) {
+        return line.empty() ? LineClass::empty : LineClass::blank;
+    }
+    if (indent >= indentLevel) {
+        return LineClass::code;
+    }
+    if (!line.tabs && text.find_first_not_of('-') == std::string_view::npos) {
+        return LineClass::underline;
+    }
+    return LineClass::text;
 }
 
-bool isDelimited(const std::string& line) {
-    if (line.empty() || (line[0] != '`' && line[0] != '~')) {
+/// returns true if `filename` exists and holds exactly `data`
+bool sameContents(const fs::path& filename, std::string_view data) {
+    std::error_code ec;
+    // cheap test first: nearly every changed file has changed size
+    if (fs::file_size(filename, ec) != data.size() || ec) {
         return false;
     }
-    size_t backtickDelim{line.find_first_not_of('`')};
-    size_t tildeDelim{line.find_first_not_of('~')};
-    return backtickDelim >= delimLength || tildeDelim >= delimLength;
-}
-
-std::string &replaceLeadingTabs(std::string &line) {
-    std::size_t tabcount{0};
-    for (auto ch: line) {
-        if (ch != '\t')
-            break;
-        ++tabcount;
+    try {
+        return MappedFile{filename}.view() == data;
     }
-    if (tabcount) {
-        line.replace(0, tabcount, indentLevel*tabcount, ' ');
+    catch (std::exception&) {
+        return false;
     }
-    return line;
 }
 
-void emit(std::ostream& out, const std::string &line) {
-    if (line.size() < indentLevel) {
-        out << line << '\n';
-    } else {
-        out << (line[0] == ' ' ? line.substr(indentLevel) : line.substr(1)) << '\n';
-    }
+void spaces(std::string& out, std::size_t count) {
+    out.append(count, ' ');
 }
 
-std::vector<Rule> loadrules(const fs::path &rulesfile) {
-    std::vector<Rule> rules;
-    std::ifstream in(rulesfile);
-    if (!in) {
-        std::cerr << "Unable to open rules file: " << rulesfile << "\n";
-        return rules;
-    }
-    std::string line;
-    unsigned linenum{0};
-    static const std::regex rulefields{"([^@]+)@([^@]*)@(.*)"}; 
-    while (std::getline(in, line)) {
-        ++linenum;
-        std::smatch pieces;
-        if (std::regex_match(line, pieces, rulefields) && pieces.size() == 4) {
-            try {
-                rules.emplace_back(pieces[1], pieces[2], pieces[3]);
-            } 
-            catch (std::regex_error& e) {
-                static constexpr std::string_view labels[4]{"line", "regex", "cmake lines", "libraries"};
-                std::cerr << "Error: " << e.what() << " in line " << linenum << " of rules file " << rulesfile << "\n";
-                for (unsigned i{0}; i < pieces.size(); ++i ) {
-                    std::cout << labels[i] << " = \"" << pieces[i] << "\"\n";
-                }
-            }
-        }
+/// write the line with its leading tabs expanded
+void write(std::string& out, const Line& line) {
+    spaces(out, line.tabs * indentLevel);
+    out += line.text;
+    out += '\n';
+}
+
+/// write the line with one level of indentation removed
+void emit(std::string& out, const Line& line) {
+    if (line.size() < indentLevel) {
+        write(out, line);
+    } else if (line.tabs) {
+        spaces(out, (line.tabs - 1) * indentLevel);
+        out += line.text;
+        out += '\n';
+    } else {
+        out += line.text.substr(line.text[0] == ' ' ? indentLevel : 1);
+        out += '\n';
     }
-    std::cout << "Loaded " << rules.size() << " rules\n";
-    return rules;
 }
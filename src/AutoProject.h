@@ -1,13 +1,17 @@
 #ifndef AUTOPROJECT_H
 #define AUTOPROJECT_H
 #include "config.h"
+#include "MappedFile.h"
 #include <exception>
 #include <fstream>
 #include <functional>
 #include <map>
+#include <memory>
+#include <set>
 #include <string>
 #include <string_view>
 #include <unordered_set>
+#include <vector>
 
 #if HAS_FILESYSTEM
 #include <filesystem>
@@ -31,35 +35,131 @@ public:
     {}
 };
 
+class RuleSet;
+
+/// what builds the generated project: CMake alone, or also a build.ninja or Makefile that needs no configure step
+enum class Generator { cmake, ninja, make };
+
+/// how a C or C++ project is optimized; with none, the build files say nothing about it
+enum class Profile { none, debug, release, native, lto };
+
 struct LangConfig {
     fs::path configdir;
     fs::path rulesfilename;
     fs::path toplevelcmakefilename;
     fs::path srclevelcmakefilename;
     fs::path clonedir;
+    // where parsed rules are cached between runs; empty for no cache
+    fs::path cachedir;
+    // ignore any cached rules and parse the rules file afresh
+    bool rebuildRuleCache = false;
+    Generator generator = Generator::cmake;
+    // the programs and flags used by the ninja and make generators; the linker defaults to the compiler
+    std::string compiler;
+    std::string compileflags;
+    std::string linker;
+    // system headers, e.g. "<iostream> <vector>", that the ninja and make generators precompile once in cachedir for every project
+    std::string sharedheaders;
+    // compile the C or C++ sources as a unity build, apart from any that might clash
+    bool unity = false;
+    // names of sources, e.g. "board.cpp game.cpp", that a unity build always compiles on their own
+    std::string unityskip;
+    Profile profile = Profile::none;
+    // probe the toolchain once into an initial cache in cachedir for the CMake preset to use
+    bool initialcache = true;
+    // how many CMake build trees to keep configured in cachedir, ready for new projects; 0 for none
+    unsigned buildpool = 0;
+    // this program, through which every compile runs to share objects in cachedir; empty for none
+    fs::path objectcache;
 };
 
 class AutoProject {
 public:
     AutoProject() = default;
     AutoProject(fs::path mdFilename, std::map<std::string, LangConfig> lang);
+    /*! construct from markdown already in memory.
+     *
+     * `mdFilename` need not exist; it only determines the project name
+     * and output directory exactly as for a file on disk.
+     */
+    AutoProject(fs::path mdFilename, std::string mdContents, std::map<std::string, LangConfig> lang);
     void open(fs::path mdFilename, std::map<std::string, LangConfig> lang);
-    // create the project
-    bool createProject(bool overwrite);
+    /*! create the project.
+     *
+     * With `incremental`, existing output is overwritten only where its
+     * contents would actually change; unchangedFiles() then says how
+     * many files were left alone.
+     *
+     * If the manifest left in the output directory by an earlier run
+     * shows that the md file, the configuration, the rules, templates
+     * and cloned files and the version are all as they were then, and
+     * every output file is still there, nothing is parsed or written at
+     * all and upToDate() is true.
+     */
+    bool createProject(bool overwrite, bool incremental = false);
+    /// output directory, e.g. "/tmp/248232"
+    const fs::path& outputDir() const { return outdir; }
+    /// names of the extracted source files, in order of first appearance
+    const std::vector<fs::path>& sourceFiles() const { return srcnames; }
+    /// number of output files found already up to date by an incremental createProject
+    std::size_t unchangedFiles() const { return unchanged; }
+    /// true if createProject found the whole project already up to date
+    bool upToDate() const { return current; }
+    /// the language of the project, e.g. "c++", once it has been created
+    const std::string& language() const { return thislang; }
+    /// the build directory relative to outputDir(), named for the profile if there is one, e.g. "build-release"
+    fs::path buildDir() const;
     /// print final status to `out`
     friend std::ostream& operator<<(std::ostream& out, const AutoProject &ap);
 
 private:
-    void writeTopLevel() const;
-    void copyCloneDir(bool overwrite) const;
-    void writeSrcLevel() const;
+    void writeTopLevel();
+    void copyCloneDir(bool overwrite);
+    void writeSrcLevel();
+    void writeBuildFiles();
+    /// write a CMakePresets.json whose preset configures with the initial cache, if there is one
+    void writePresets();
+    /// make the build directory one that the build pool configured ahead of time, if it has one
+    void takeBuildTree();
+    bool writeFile(const fs::path& filename, std::string_view data);
     void makeTree(bool overwrite);
+    bool readManifest(std::string_view mdDigest);
+    void writeManifest(std::string_view mdDigest) const;
+    /// the configuration, rules, template and cloned files the project was made from
+    std::vector<fs::path> inputFiles() const;
+    std::string configDigest() const;
+    /// digest of the compiler and linker used for language `name`, or an empty string if none are used
+    std::string toolchainDigest(const std::string& name) const;
     /*! check the passed line against the rule set.
      *
-     * If it matches, add the corresponding rule to `extraRules`.
+     * If it matches, add the corresponding rule to `triggered`.  What
+     * it includes, and whether it defines main(), is noted in `scan` as
+     * well.
+     */
+    void checkRules(std::string_view line);
+    void checkStructure(std::string_view line);
+    /// the target_precompile_headers command for the headers most sources include, if worthwhile
+    std::string precompiledHeaders() const;
+    /// an executable to build, with the sources no other program needs
+    struct Program {
+        std::string name;
+        std::vector<fs::path> sources;
+    };
+    /*! the programs to build if the sources define main() more than once.
+     *
+     * The first program is named for the project, and the sources that
+     * several of them, or none of them, need are put in `shared`.  With
+     * fewer than two definitions of main() there is only the one
+     * program, as ever, and the result is empty.
      */
-    void checkRules(const std::string &line);
-    void checkLanguageTags(const std::string& line);
+    std::vector<Program> programs(std::vector<fs::path>& shared) const;
+    /// the CMake commands that build the programs after the first one, and the sources they share
+    std::string programTargets(const std::vector<Program>& progs, const std::vector<fs::path>& shared, const std::string& libraries) const;
+    void checkLanguageTags(std::string_view line);
+    /// name of the file for source that isn't preceded by a filename
+    std::string mainSourceName() const;
+    /// the markdown input, either mapped from mdfile or held in mdtext
+    std::string_view contents() const;
 
     // full path to input md file, e.g. "/tmp/248232.md"
     fs::path mdfile;
@@ -68,15 +168,61 @@ private:
     // project name, e.g. "248232"
     std::string projname;
     std::string srcdir;
-    std::ifstream in;
+    // the contents of mdfile, mapped from disk or supplied by the caller
+    MappedFile mapped;
+    std::string mdtext;
     fs::path configdir;
     fs::path toplevelfilename;
     fs::path srclevelfilename;
     fs::path clonedir;
-    std::unordered_set<fs::path, path_hash> srcnames;
-    std::unordered_set<std::string> extraRules;
-    std::unordered_set<std::string> libraries;
+    // kept in order so that the generated files are reproducible
+    std::vector<fs::path> srcnames;
+    // ids of the rules triggered by the sources, in rules file order
+    std::set<std::size_t> triggered;
+    // rules for thislang; immutable and shared with every other instance using the same rules file
+    std::shared_ptr<const RuleSet> rules;
     std::string thislang;
     std::map<std::string, LangConfig> lang;
+    // only rewrite output files whose contents change
+    bool incremental = false;
+    // output files left alone because they were already up to date
+    std::size_t unchanged = 0;
+    // every file written, for the manifest
+    std::vector<fs::path> outputs;
+    // the manifest showed that there was nothing to do
+    bool current = false;
+    // sources with file-local definitions that a unity build must compile on their own
+    std::vector<fs::path> unityExcluded;
+    // the sources that define each file scope class, struct, union or enum, by its name
+    std::map<std::string, std::vector<fs::path>> typeDefiners;
+    /// what the source file being extracted includes and defines
+    struct Scan {
+        // system headers included outside any #if
+        std::set<std::string> headers;
+        // extracted files it includes with #include "...", by file name
+        std::vector<fs::path> locals;
+        // it defines main()
+        bool main = false;
+        // how deeply the current line is nested in #if
+        unsigned conditionals = 0;
+        // a macro was defined or undefined before a system header was included
+        bool definesFirst = false;
+        bool defines = false;
+    };
+    Scan scan;
+    // how many compiled sources include each system header
+    std::map<std::string, std::size_t> systemHeaders;
+    // sources whose own macros affect the system headers they include, so they cannot share a precompiled header
+    std::vector<fs::path> pchExcluded;
+    // the shared header in the cache directory that the build file includes, if any
+    fs::path sharedHeader;
+    // the initial cache in the cache directory that the preset uses, if any
+    fs::path initialCache;
+    // the build directory was taken from the build pool, already configured
+    bool warmBuild = false;
+    // the include graph: the files each extracted file includes with #include "..."
+    std::map<fs::path, std::vector<fs::path>> localIncludes;
+    // the sources that define main(), in order of appearance
+    std::vector<fs::path> entryPoints;
 };
 #endif // AUTOPROJECT_H
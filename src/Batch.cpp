@@ -0,0 +1,104 @@
+#include "config.h"
+#include "Batch.h"
+#include "WorkPool.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <set>
+
+namespace {
+struct Result {
+    fs::path mdfile;
+    bool ok = false;
+    std::string message;
+    std::size_t unchanged = 0;
+    bool upToDate = false;
+};
+
+// expand directories into the md files they contain, dropping duplicates
+std::vector<fs::path> expandInputs(const std::vector<fs::path>& inputs) {
+    std::vector<fs::path> files;
+    std::set<fs::path> seen;
+    auto add = [&](const fs::path& file) {
+        std::error_code ec;
+        auto canonical{fs::weakly_canonical(file, ec)};
+        if (seen.insert(ec ? file : canonical).second) {
+            files.push_back(file);
+        }
+    };
+    for (const auto& input : inputs) {
+        if (fs::is_directory(input)) {
+            std::vector<fs::path> found;
+            for (const auto& entry : fs::directory_iterator(input)) {
+                if (entry.is_regular_file() && entry.path().extension() == ".md") {
+                    found.push_back(entry.path());
+                }
+            }
+            std::sort(found.begin(), found.end());
+            std::for_each(found.begin(), found.end(), add);
+        } else {
+            add(input);
+        }
+    }
+    return files;
+}
+}
+
+std::size_t runBatch(const std::vector<fs::path>& inputs, unsigned jobs, bool overwrite, bool incremental, const std::map<std::string, LangConfig>& lang) {
+    const auto files{expandInputs(inputs)};
+    std::vector<Result> results(files.size());
+    const auto start{std::chrono::steady_clock::now()};
+    {
+        // a thread with no file to work on would only sit idle
+        WorkPool pool{static_cast<unsigned>(std::min<std::size_t>(jobs, files.size()))};
+        std::cout << "Processing " << files.size() << " files using " << pool.size() << " threads\n";
+        for (std::size_t i{0}; i < files.size(); ++i) {
+            pool.submit([&, i]{
+                auto& result{results[i]};
+                result.mdfile = files[i];
+                try {
+                    AutoProject ap{files[i], lang};
+                    result.ok = ap.createProject(overwrite, incremental);
+                    result.unchanged = ap.unchangedFiles();
+                    result.upToDate = ap.upToDate();
+                    if (!result.ok) {
+                        result.message = "no source files found";
+                    }
+                }
+                catch (std::exception& e) {
+                    result.message = e.what();
+                }
+            });
+        }
+        pool.wait();
+    }
+    const std::chrono::duration<double> elapsed{std::chrono::steady_clock::now() - start};
+
+    std::size_t failed{0};
+    std::size_t unchanged{0};
+    std::size_t upToDate{0};
+    for (const auto& result : results) {
+        unchanged += result.unchanged;
+        if (result.upToDate) {
+            ++upToDate;
+            std::cout << "OK     " << result.mdfile.string() << " (up to date)\n";
+        } else if (result.ok) {
+            std::cout << "OK     " << result.mdfile.string() << '\n';
+        } else {
+            ++failed;
+            std::cout << "FAILED " << result.mdfile.string() << ": " << result.message << '\n';
+        }
+    }
+    const auto seconds{elapsed.count()};
+    std::cout << "Processed " << results.size() << " files in " << std::fixed << std::setprecision(3) << seconds << " s ("
+        << std::setprecision(1) << (seconds > 0 ? results.size() / seconds : 0.0) << " files/s): "
+        << results.size() - failed << " succeeded, " << failed << " failed\n";
+    if (upToDate) {
+        std::cout << upToDate << " projects were already up to date\n";
+    }
+    if (incremental) {
+        std::cout << unchanged << " unchanged output files were left as they were\n";
+    }
+    return failed;
+}
@@ -0,0 +1,21 @@
+#ifndef BATCH_H
+#define BATCH_H
+#include "AutoProject.h"
+#include <map>
+#include <string>
+#include <vector>
+
+/*! Create a project for each of the passed inputs on a pool of `jobs` threads,
+ * or one per file if there are fewer files than that.
+ *
+ * Each input is either an md file or a directory, in which case every
+ * file with an .md extension directly inside it is processed.  The
+ * configuration and rules are loaded once and shared by every file.
+ * A per-file summary and the overall throughput are printed to `std::cout`.
+ * With `incremental`, only output files whose contents change are written.
+ * Projects already up to date with their md file are skipped entirely.
+ *
+ * @return the number of inputs that failed
+ */
+std::size_t runBatch(const std::vector<fs::path>& inputs, unsigned jobs, bool overwrite, bool incremental, const std::map<std::string, LangConfig>& lang);
+#endif // BATCH_H
@@ -0,0 +1,265 @@
+#include "BuildFile.h"
+#include "Json.h"
+#include "Process.h"
+#include <algorithm>
+#include <set>
+#include <sstream>
+#include <string_view>
+
+// helper functions
+static std::string ninjaPath(const fs::path& path);
+static std::string ninjaValue(const std::string& value);
+static std::string makePath(const fs::path& path);
+static std::string makeValue(const std::string& value);
+static fs::path objectFile(const BuildSpec& spec, const fs::path& source);
+static std::vector<std::string> words(const std::string& text);
+static bool linkOnly(std::string_view flag);
+static bool compileOnly(std::string_view flag);
+static std::string compileFlags(const BuildSpec& spec);
+static bool unshared(const BuildSpec& spec, const fs::path& source);
+
+// BuildFile interface functions
+
+void addRuleFlags(BuildSpec& spec, const std::string& flags) {
+    // options whose value may be the next word
+    static const std::set<std::string_view> valued{"-I", "-isystem", "-iquote", "-idirafter", "-D", "-U", "-include", "-L", "-framework"};
+    const auto flagWords{words(flags)};
+    for (std::size_t i{0}; i < flagWords.size(); ++i) {
+        auto flag{flagWords[i]};
+        if (valued.count(flag) && i + 1 < flagWords.size()) {
+            flag += ' ' + flagWords[++i];
+        }
+        if (!linkOnly(flag)) {
+            spec.compileFlags += (spec.compileFlags.empty() ? "" : " ") + flag;
+        }
+        if (!compileOnly(flag)) {
+            spec.linkFlags += (spec.linkFlags.empty() ? "" : " ") + flag;
+        }
+    }
+}
+
+/*! Each source is compiled to its own object, with the compiler's
+ * dependency output telling ninja which headers it includes, and the
+ * objects are then linked into `<buildDir>/<target>`.  `ninja run` builds
+ * and runs it.
+ */
+std::string ninjaFile(const BuildSpec& spec) {
+    const auto executable{ninjaPath(spec.buildDir / spec.target)};
+    std::ostringstream out;
+    out << "# build.ninja for " << spec.target << ", written by autoproject\n";
+    if (!spec.compilerVersion.empty()) {
+        out << "# compiler: " << spec.compilerVersion << '\n';
+    }
+    out << "ninja_required_version = 1.3\n"
+        << "compiler = " << ninjaValue(spec.compiler.string()) << '\n'
+        << "compileflags = " << ninjaValue(compileFlags(spec)) << '\n'
+        << "linker = " << ninjaValue(spec.linker.string()) << '\n'
+        << "linkflags = " << ninjaValue(spec.linkFlags) << '\n';
+    const bool launched{spec.gccStyle && !spec.launcher.empty()};
+    if (launched) {
+        out << "launcher = " << ninjaValue(spec.launcher) << '\n';
+    }
+    out << '\n';
+    if (spec.gccStyle) {
+        out << "rule compile\n"
+            << "  command = " << (launched ? "$launcher " : "") << "$compiler $compileflags -MD -MF $out.d -c $in -o $out\n"
+            << "  depfile = $out.d\n"
+            << "  deps = gcc\n";
+    } else {
+        out << "rule compile\n"
+            << "  command = $compiler $compileflags $in -o $out\n";
+    }
+    out << "  description = Compiling $in\n"
+        << "rule link\n"
+        << "  command = $linker $in -o $out $linkflags\n"
+        << "  description = Linking $out\n"
+        << "rule run\n"
+        << "  command = ./$in\n"
+        << "  pool = console\n"
+        << "  description = Running $in\n\n";
+    std::string objects;
+    for (const auto& source : spec.sources) {
+        const auto object{ninjaPath(objectFile(spec, source))};
+        out << "build " << object << ": compile " << ninjaPath(source) << '\n';
+        if (unshared(spec, source)) {
+            out << "  compileflags = " << ninjaValue(spec.compileFlags) << '\n';
+        }
+        objects += ' ' + object;
+    }
+    out << "build " << executable << ": link" << objects << '\n'
+        << "build run: run " << executable << '\n'
+        << "default " << executable << '\n';
+    return out.str();
+}
+
+/*! The same build as ninjaFile(), for make; `make run` builds and runs
+ * the executable and `make clean` removes what was built.
+ */
+std::string makeFile(const BuildSpec& spec) {
+    const auto executable{makePath(spec.buildDir / spec.target)};
+    std::ostringstream out;
+    out << "# Makefile for " << spec.target << ", written by autoproject\n";
+    if (!spec.compilerVersion.empty()) {
+        out << "# compiler: " << spec.compilerVersion << '\n';
+    }
+    out << "COMPILER = " << makeValue(spec.compiler.string()) << '\n'
+        << "COMPILEFLAGS = " << makeValue(compileFlags(spec)) << '\n'
+        << "LINKER = " << makeValue(spec.linker.string()) << '\n'
+        << "LINKFLAGS = " << makeValue(spec.linkFlags) << '\n';
+    const bool launched{spec.gccStyle && !spec.launcher.empty()};
+    if (launched) {
+        out << "LAUNCHER = " << makeValue(spec.launcher) << '\n';
+    }
+    out << "OBJECTS =";
+    for (const auto& source : spec.sources) {
+        out << ' ' << makePath(objectFile(spec, source));
+    }
+    out << "\n\n"
+        << executable << ": $(OBJECTS)\n"
+        << "\t$(LINKER) $(OBJECTS) -o $@ $(LINKFLAGS)\n\n";
+    for (const auto& source : spec.sources) {
+        if (unshared(spec, source)) {
+            out << makePath(objectFile(spec, source)) << ": COMPILEFLAGS = " << makeValue(spec.compileFlags) << '\n';
+        }
+        out << makePath(objectFile(spec, source)) << ": " << makePath(source) << '\n'
+            << (launched ? "\t$(LAUNCHER) " : "\t")
+            << (spec.gccStyle ? "$(COMPILER) $(COMPILEFLAGS) -MMD -MP -MF $@.d -c $< -o $@\n" : "$(COMPILER) $(COMPILEFLAGS) $< -o $@\n");
+    }
+    out << '\n';
+    if (spec.gccStyle) {
+        out << "-include $(OBJECTS:=.d)\n\n";
+    }
+    out << ".PHONY: run clean\n"
+        << "run: " << executable << "\n"
+        << "\t./" << executable << '\n'
+        << "clean:\n"
+        << "\trm -f " << executable << " $(OBJECTS)" << (spec.gccStyle ? " $(OBJECTS:=.d)" : "") << '\n';
+    return out.str();
+}
+
+/*! Each source gets one entry with the compile command split into
+ * arguments, so that clangd and clang-tidy need no CMake configure to
+ * find out how it is built.  The shared header is left out, since Clang
+ * cannot read a header GCC precompiled.
+ */
+std::string compilationDatabase(const BuildSpec& spec, const fs::path& directory) {
+    std::string out{"["};
+    for (const auto& source : spec.sources) {
+        Json arguments{Json::array()};
+        arguments.push_back(spec.compiler.string());
+        for (const auto& flag : words(spec.compileFlags)) {
+            arguments.push_back(flag);
+        }
+        if (spec.gccStyle) {
+            arguments.push_back("-c");
+        }
+        arguments.push_back(source.generic_string());
+        arguments.push_back("-o");
+        arguments.push_back(objectFile(spec, source).generic_string());
+        Json entry{Json::object()};
+        entry.set("directory", directory.string());
+        entry.set("arguments", std::move(arguments));
+        entry.set("file", source.generic_string());
+        entry.set("output", objectFile(spec, source).generic_string());
+        out += (out.size() > 1 ? ",\n  " : "\n  ") + entry.dump();
+    }
+    out += "\n]\n";
+    return out;
+}
+
+// helper functions
+
+/// `path` as it must be written in a ninja build statement
+std::string ninjaPath(const fs::path& path) {
+    std::string escaped;
+    for (const char ch : path.generic_string()) {
+        if (ch == '$' || ch == ' ' || ch == ':') {
+            escaped += '$';
+        }
+        escaped += ch;
+    }
+    return escaped;
+}
+
+/// `value` as it must be written in a ninja variable
+std::string ninjaValue(const std::string& value) {
+    std::string escaped;
+    for (const char ch : value) {
+        if (ch == '$') {
+            escaped += '$';
+        }
+        escaped += ch;
+    }
+    return escaped;
+}
+
+/// `path` as it must be written in a make rule
+std::string makePath(const fs::path& path) {
+    std::string escaped;
+    for (const char ch : path.generic_string()) {
+        if (ch == ' ' || ch == '#') {
+            escaped += '\\';
+        } else if (ch == '$') {
+            escaped += '$';
+        }
+        escaped += ch;
+    }
+    return escaped;
+}
+
+/// `value` as it must be written in a make variable
+std::string makeValue(const std::string& value) {
+    std::string escaped;
+    for (const char ch : value) {
+        if (ch == '#') {
+            escaped += '\\';
+        } else if (ch == '$') {
+            escaped += '$';
+        }
+        escaped += ch;
+    }
+    return escaped;
+}
+
+/// the object file for `source`; sources all share one directory, so their names are unique
+fs::path objectFile(const BuildSpec& spec, const fs::path& source) {
+    return spec.buildDir / (source.filename().string() + ".o");
+}
+
+/// the flags for compiling each source, including the shared header if there is one
+std::string compileFlags(const BuildSpec& spec) {
+    if (spec.sharedHeader.empty()) {
+        return spec.compileFlags;
+    }
+    return spec.compileFlags + (spec.compileFlags.empty() ? "" : " ") + "-include " + shellQuoted(spec.sharedHeader);
+}
+
+/// returns true if `source` is compiled without the shared header that the others include
+bool unshared(const BuildSpec& spec, const fs::path& source) {
+    return !spec.sharedHeader.empty() && std::find(spec.unshared.begin(), spec.unshared.end(), source) != spec.unshared.end();
+}
+
+/// `text` split at blanks
+std::vector<std::string> words(const std::string& text) {
+    std::vector<std::string> result;
+    std::istringstream in{text};
+    for (std::string word; in >> word; ) {
+        result.push_back(word);
+    }
+    return result;
+}
+
+/// returns true if `flag` only matters when linking
+bool linkOnly(std::string_view flag) {
+    return flag.substr(0, 2) == "-l" || flag.substr(0, 2) == "-L" || flag.substr(0, 4) == "-Wl," || flag.substr(0, 10) == "-framework";
+}
+
+/// returns true if `flag` only matters when compiling
+bool compileOnly(std::string_view flag) {
+    for (const std::string_view prefix : { "-I", "-D", "-U", "-isystem", "-iquote", "-idirafter", "-include" }) {
+        if (flag.substr(0, prefix.size()) == prefix) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,58 @@
+#ifndef BUILDFILE_H
+#define BUILDFILE_H
+#include "config.h"
+#include <string>
+#include <vector>
+
+#if HAS_FILESYSTEM
+#include <filesystem>
+namespace fs = std::filesystem;
+#else
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#endif
+
+/*! Everything a build file needs to build a project directly.
+ *
+ * The build files written from this run the compiler themselves rather
+ * than having CMake find one and write them, so a project can be built
+ * without any configure step.  They live in the project's top directory
+ * and put the objects and the executable in its build directory.
+ */
+struct BuildSpec {
+    /// name of the executable
+    std::string target;
+    /// the files to compile, relative to the project directory
+    std::vector<fs::path> sources;
+    fs::path compiler;
+    /// identifies the compiler in a comment, e.g. its version
+    std::string compilerVersion;
+    std::string compileFlags;
+    fs::path linker;
+    std::string linkFlags;
+    /// the compiler takes gcc style -c and -MD options, so header dependencies can be tracked
+    bool gccStyle = true;
+    /// a command that each gcc style compile is run through, such as an object cache; may be empty
+    std::string launcher;
+    /// a header to include ahead of every source, such as one precompiled for many projects; may be empty
+    fs::path sharedHeader;
+    /// sources compiled without the shared header, such as those that define a macro ahead of their includes
+    std::vector<fs::path> unshared;
+    /// where the objects and the executable go, relative to the project directory
+    fs::path buildDir{"build"};
+};
+
+/*! add the flags of a rule, such as "-pthread" or "-lpng", to `spec`.
+ *
+ * Those that only matter when linking, such as -l, go to its link flags,
+ * those that only matter when compiling, such as -I, to its compile
+ * flags, and the rest, such as -pthread, to both.
+ */
+void addRuleFlags(BuildSpec& spec, const std::string& flags);
+/// the contents of a build.ninja for `spec`
+std::string ninjaFile(const BuildSpec& spec);
+/// the contents of a Makefile for `spec`
+std::string makeFile(const BuildSpec& spec);
+/// the contents of a compile_commands.json for `spec`, as if built in the absolute path `directory`
+std::string compilationDatabase(const BuildSpec& spec, const fs::path& directory);
+#endif // BUILDFILE_H
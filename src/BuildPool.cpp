@@ -0,0 +1,196 @@
+#include "BuildPool.h"
+#include "Hash.h"
+#include "InitialCache.h"
+#include "Process.h"
+#include "Tool.h"
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <string_view>
+#include <vector>
+
+// local constants
+static const std::string readyPrefix{"ready-"};
+static const std::string fillPrefix{"fill-"};
+static const fs::path templateName{"CMakeLists.txt"};
+// a tree still being configured after this long was abandoned, e.g. by a reboot
+static constexpr std::chrono::minutes abandoned{10};
+// cache entries that belong to the generator the pool used rather than to the toolchain
+static const std::set<std::string_view> generatorEntries{
+    "CMAKE_EXTRA_GENERATOR", "CMAKE_GENERATOR", "CMAKE_GENERATOR_INSTANCE",
+    "CMAKE_GENERATOR_PLATFORM", "CMAKE_GENERATOR_TOOLSET", "CMAKE_MAKE_PROGRAM",
+};
+
+// helper functions
+static std::vector<fs::path> entries(const fs::path& dir, const std::string& prefix);
+static bool relocate(const fs::path& tree, const fs::path& builddir, const fs::path& pooldir);
+static bool isGeneratorEntry(std::string_view line);
+
+// BuildPool interface functions
+BuildPool::BuildPool(const std::string& cmakelists, const fs::path& cachedir, unsigned size) :
+    size{size}
+{
+    if (cachedir.empty() || size == 0) {
+        return;
+    }
+    const auto toolchain{InitialCache::toolchainDigest(cachedir)};
+    if (toolchain.empty()) {
+        return;
+    }
+    cmake = Tool::shared("cmake", cachedir)->path;
+    // CMake writes absolute paths, and those into the pool are recognized by this prefix
+    const auto pooldir{fs::absolute(cachedir) / ("pool-" + hexDigest(fnv1a(cmakelists, fnv1a("\n", fnv1a(toolchain)))))};
+    std::error_code ec;
+    if (!fs::exists(pooldir / templateName, ec)) {
+        replaceFile(pooldir / templateName, [&](const fs::path& tmpfile) {
+            std::ofstream out{tmpfile};
+            out << cmakelists;
+            out.close();
+            return static_cast<bool>(out);
+        });
+    }
+    if (fs::exists(pooldir / templateName, ec)) {
+        dir = pooldir;
+    }
+}
+
+bool BuildPool::take(const fs::path& builddir) const {
+    if (dir.empty()) {
+        return false;
+    }
+    for (const auto& tree : entries(dir, readyPrefix)) {
+        // whoever renames a tree first has it
+        const auto claimed{dir / ("taken-" + uniqueSuffix())};
+        std::error_code ec;
+        fs::rename(tree, claimed, ec);
+        if (ec) {
+            continue;
+        }
+        const bool relocated{relocate(claimed, builddir, dir)};
+        fs::remove_all(claimed, ec);
+        if (relocated) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*! Each tree is configured into a `fill-` directory, which is made here
+ * so that it counts at once, and renamed to a `ready-` one only once
+ * CMake has succeeded.
+ */
+void BuildPool::refill() const {
+    if (dir.empty()) {
+        return;
+    }
+#ifdef _WIN32
+    static const std::string move{"move "};
+    static const std::string removeTree{"rmdir /s /q "};
+#else
+    static const std::string move{"mv "};
+    static const std::string removeTree{"rm -rf "};
+#endif
+    // held so that the threads of a batch do not each start the same trees
+    static std::mutex mtx;
+    std::lock_guard<std::mutex> lock{mtx};
+    std::error_code ec;
+    std::size_t count{ready()};
+    for (const auto& fill : entries(dir, fillPrefix)) {
+        if (fs::file_time_type::clock::now() - fs::last_write_time(fill, ec) > abandoned) {
+            fs::remove_all(fill, ec);
+        } else {
+            ++count;
+        }
+    }
+    for ( ; count < size; ++count) {
+        const auto suffix{uniqueSuffix()};
+        const auto fill{dir / (fillPrefix + suffix)};
+        if (!fs::create_directory(fill, ec)) {
+            return;
+        }
+        startCommand(shellQuoted(cmake) + " -S " + shellQuoted(dir) + " -B " + shellQuoted(fill)
+            + " > " + shellQuoted(fill / "pool.log") + " 2>&1 && " + move + shellQuoted(fill) + ' ' + shellQuoted(dir / (readyPrefix + suffix))
+            + " || " + removeTree + shellQuoted(fill), dir);
+    }
+}
+
+std::size_t BuildPool::ready() const {
+    return dir.empty() ? 0 : entries(dir, readyPrefix).size();
+}
+
+// helper functions
+
+/// the entries of `dir` whose names start with `prefix`
+std::vector<fs::path> entries(const fs::path& dir, const std::string& prefix) {
+    std::vector<fs::path> found;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(dir, ec)) {
+        if (entry.path().filename().string().rfind(prefix, 0) == 0) {
+            found.push_back(entry.path());
+        }
+    }
+    return found;
+}
+
+/*! Copy what a configure of `builddir` can use from the configured
+ * `tree` of the pool in `pooldir`.
+ *
+ * That is the cache, less every entry that names a path in the pool,
+ * such as the source and binary directories, which CMake then sets
+ * afresh, those of the template's own project, and those of the
+ * generator, so that the project may use another; and the files under
+ * CMakeFiles/<version> that describe the system and each compiler.  The
+ * cache is written last, so that CMake never finds it without the rest.
+ */
+bool relocate(const fs::path& tree, const fs::path& builddir, const fs::path& pooldir) {
+    std::ifstream in{tree / "CMakeCache.txt"};
+    if (!in) {
+        return false;
+    }
+    std::error_code ec;
+    fs::path version;
+    for (const auto& entry : fs::directory_iterator(tree / "CMakeFiles", ec)) {
+        if (fs::exists(entry.path() / "CMakeSystem.cmake", ec)) {
+            version = entry.path().filename();
+            break;
+        }
+    }
+    if (version.empty()) {
+        return false;
+    }
+    const auto target{builddir / "CMakeFiles" / version};
+    fs::create_directories(target, ec);
+    for (const auto& entry : fs::directory_iterator(tree / "CMakeFiles" / version, ec)) {
+        if (!ec && entry.path().extension() == ".cmake") {
+            fs::copy_file(entry.path(), target / entry.path().filename(), fs::copy_options::overwrite_existing, ec);
+        }
+    }
+    if (ec) {
+        fs::remove_all(builddir / "CMakeFiles", ec);
+        return false;
+    }
+    // each entry is preceded by its help text, which goes with it
+    const auto pool{pooldir.string()};
+    std::string text;
+    std::string help;
+    for (std::string line; std::getline(in, line); ) {
+        if (line.rfind("//", 0) == 0) {
+            help += line + '\n';
+            continue;
+        }
+        if (line.find(pool) == std::string::npos && line.rfind("autoproject_probe_", 0) != 0 && !isGeneratorEntry(line)) {
+            text += help + line + '\n';
+        }
+        help.clear();
+    }
+    std::ofstream{builddir / "CMakeCache.txt"} << text;
+    return true;
+}
+
+/// true if the cache `line` sets one of `generatorEntries` or a property of one
+bool isGeneratorEntry(std::string_view line) {
+    auto name{line.substr(0, line.find_first_of(":="))};
+    name = name.substr(0, name.find('-'));
+    return generatorEntries.find(name) != generatorEntries.end();
+}
@@ -0,0 +1,57 @@
+#ifndef BUILDPOOL_H
+#define BUILDPOOL_H
+#include "config.h"
+#include <cstddef>
+#include <string>
+
+#if HAS_FILESYSTEM
+#include <filesystem>
+namespace fs = std::filesystem;
+#else
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#endif
+
+/*! A pool of CMake build trees configured ahead of time for new projects.
+ *
+ * Configuring a new build tree means identifying and testing the
+ * compilers and running the searches of each find_package, none of which
+ * depends on the project.  The pool keeps a few trees already configured
+ * from a template CMakeLists.txt, in a directory of the cache directory
+ * named for the digest of the toolchain and the template, and a new
+ * project takes one as its build directory.  Its first configure then
+ * only reads what is already there and generates the build system for
+ * the project's own sources.
+ *
+ * A tree is only ever taken by renaming it, so several threads or
+ * processes can share the pool.  New trees are configured in the
+ * background by CMake itself, so they may still be on their way when
+ * this program exits.
+ */
+class BuildPool {
+public:
+    /*! the pool in `cachedir` of trees configured from `cmakelists`,
+     * which is kept at `size` trees.
+     *
+     * If CMake cannot be found or `size` is zero, `dir` is empty and the
+     * pool is always empty.
+     */
+    BuildPool(const std::string& cmakelists, const fs::path& cachedir, unsigned size);
+    /*! move a configured tree from the pool into `builddir`, which has
+     * not been configured itself.
+     *
+     * @return true if there was a tree to take
+     */
+    bool take(const fs::path& builddir) const;
+    /// start configuring trees in the background until there are `size`, counting those already on their way
+    void refill() const;
+    /// the number of trees ready to be taken
+    std::size_t ready() const;
+
+    /// the directory of the pool, which holds the template and the trees
+    fs::path dir;
+private:
+    fs::path cmake;
+    unsigned size;
+};
+#endif // BUILDPOOL_H
@@ -0,0 +1,85 @@
+#include "config.h"
+#include "CMakeBuild.h"
+#include "Tool.h"
+#include <algorithm>
+#include <stdexcept>
+
+// local constants
+// a run taking longer than this is most likely waiting for input that never comes
+static constexpr std::chrono::minutes runLimit{2};
+// each program is timed this many times and the best time is kept
+static constexpr int timedRuns{3};
+static const fs::path logName{"autoproject.log"};
+#ifdef _WIN32
+static const std::string nullDevice{"NUL"};
+static const std::string executableSuffix{".exe"};
+#else
+static const std::string nullDevice{"/dev/null"};
+static const std::string executableSuffix;
+#endif
+
+// CMakeBuild interface functions
+CMakeBuild::CMakeBuild(const AutoProject& ap, const std::string& args) :
+    dir{fs::absolute(ap.outputDir())},
+    name{ap.outputDir().filename().string()},
+    args{args}
+{
+    if (ap.language() != "c" && ap.language() != "c++") {
+        throw std::runtime_error("only C and C++ projects can be built");
+    }
+    const auto tool{Tool::shared("cmake")};
+    if (!tool) {
+        throw std::runtime_error("cmake was not found");
+    }
+    cmake = tool->path;
+    if (this->args.empty()) {
+        this->args = "< " + (fs::exists(dir / "src" / "input.txt") ? std::string{"input.txt"} : nullDevice);
+    }
+}
+
+void CMakeBuild::configure(const fs::path& builddir, const std::vector<std::string>& definitions) const {
+    std::string command{shellQuoted(cmake) + " -S " + shellQuoted(dir) + " -B " + shellQuoted(builddir)};
+    for (const auto& definition : definitions) {
+        command += " " + shellQuoted("-D" + definition);
+    }
+    step("configuring", builddir, command);
+}
+
+std::chrono::duration<double> CMakeBuild::build(const fs::path& builddir) const {
+    const auto start{std::chrono::steady_clock::now()};
+    step("building", builddir, shellQuoted(cmake) + " --build " + shellQuoted(builddir));
+    return std::chrono::steady_clock::now() - start;
+}
+
+fs::path CMakeBuild::program(const fs::path& builddir) const {
+    return builddir / "src" / (name + executableSuffix);
+}
+
+CommandResult CMakeBuild::run(const fs::path& builddir) const {
+    return runCommand(shellQuoted(program(builddir)) + ' ' + args + " > " + nullDevice, dir / "src", runLimit);
+}
+
+std::chrono::duration<double> CMakeBuild::bestTime(const fs::path& builddir) const {
+    std::chrono::duration<double> best{};
+    for (int i{0}; i < timedRuns; ++i) {
+        const auto result{run(builddir)};
+        if (result.timedOut) {
+            throw std::runtime_error(program(builddir).string() + " did not finish within " + std::to_string(runLimit.count()) + " minutes");
+        }
+        // a crash or an error exit is not a run time worth comparing
+        if (result.status != 0) {
+            throw std::runtime_error(program(builddir).string() + " exited with status " + std::to_string(result.status));
+        }
+        best = i == 0 ? result.elapsed : std::min(best, result.elapsed);
+    }
+    return best;
+}
+
+/// run `command` for `builddir`, logging its output there, and throw if it fails
+void CMakeBuild::step(const std::string& what, const fs::path& builddir, const std::string& command) const {
+    fs::create_directories(builddir);
+    const auto log{builddir / logName};
+    if (runCommand(command + " >> " + shellQuoted(log) + " 2>&1", dir).status != 0) {
+        throw std::runtime_error(what + ' ' + builddir.filename().string() + " failed; see " + log.string());
+    }
+}
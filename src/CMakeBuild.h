@@ -0,0 +1,46 @@
+#ifndef CMAKEBUILD_H
+#define CMAKEBUILD_H
+#include "AutoProject.h"
+#include "Process.h"
+#include <chrono>
+#include <string>
+#include <vector>
+
+/*! Builds of a project that autoproject has created, each with CMake in
+ * a build directory of its own, and timed runs of the program they build.
+ *
+ * The output of each configure and build goes to `autoproject.log` in
+ * its build directory.  The program is run in the project's src
+ * directory with the arguments, and any redirections, given as `args`,
+ * e.g. "100000 < input.txt".  If `args` is empty, it reads `input.txt`
+ * there if there is one, and otherwise nothing.  Its output is
+ * discarded.
+ */
+class CMakeBuild {
+public:
+    /// throws std::runtime_error if the project is not C or C++ or CMake cannot be found
+    CMakeBuild(const AutoProject& ap, const std::string& args);
+    /// configure `builddir` with the cache `definitions`, e.g. "AUTOPROJECT_PGO=use"; throws std::runtime_error on failure
+    void configure(const fs::path& builddir, const std::vector<std::string>& definitions) const;
+    /// build `builddir` and return how long that took; throws std::runtime_error on failure
+    std::chrono::duration<double> build(const fs::path& builddir) const;
+    /// the program built in `builddir`
+    fs::path program(const fs::path& builddir) const;
+    /// run the program built in `builddir` once; a run that takes too long is stopped
+    CommandResult run(const fs::path& builddir) const;
+    /// the best time of several runs of the program built in `builddir`; throws std::runtime_error if one takes too long or fails
+    std::chrono::duration<double> bestTime(const fs::path& builddir) const;
+    /// the absolute path of the project directory
+    const fs::path& projectDir() const { return dir; }
+    /// the arguments the program is actually run with
+    const std::string& arguments() const { return args; }
+
+private:
+    void step(const std::string& what, const fs::path& builddir, const std::string& command) const;
+
+    fs::path cmake;
+    fs::path dir;
+    std::string name;
+    std::string args;
+};
+#endif // CMAKEBUILD_H
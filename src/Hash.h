@@ -0,0 +1,29 @@
+#ifndef HASH_H
+#define HASH_H
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/*! 64-bit FNV-1a hash of `data`.
+ *
+ * Passing the result of one call as `hash` to the next hashes the
+ * concatenation of the pieces.  This is for recognizing unchanged
+ * content, not for security.
+ */
+inline std::uint64_t fnv1a(std::string_view data, std::uint64_t hash = 0xcbf29ce484222325u) {
+    for (const unsigned char ch : data) {
+        hash = (hash ^ ch) * 0x100000001b3u;
+    }
+    return hash;
+}
+
+/// the hash as 16 lowercase hex digits, suitable for a file name
+inline std::string hexDigest(std::uint64_t hash) {
+    static constexpr char digits[]{"0123456789abcdef"};
+    std::string hex(16, '0');
+    for (auto it{hex.rbegin()}; it != hex.rend(); ++it, hash >>= 4) {
+        *it = digits[hash & 0xf];
+    }
+    return hex;
+}
+#endif // HASH_H
@@ -0,0 +1,210 @@
+#include "InitialCache.h"
+#include "Hash.h"
+#include "Process.h"
+#include "Tool.h"
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <regex>
+#include <sstream>
+
+// local constants
+// left in the directory when the probe fails, so that no one tries again for a while
+static const fs::path failedName{"failed"};
+static const fs::path cacheName{"initial-cache.cmake"};
+// what CMake said about the last failed probe
+static const fs::path logName{"probe.log"};
+// a failure this old may have been a passing one, such as a full disk, so the probe is tried again
+static constexpr std::chrono::hours retryAfter{24};
+
+// helper functions
+static std::string compilerName(const char *variable, const char *fallback);
+static std::string compilerSettings(const fs::path& builddir);
+static std::string packageSettings(const fs::path& cachefile);
+static std::string cacheValue(std::string_view value);
+
+// InitialCache interface functions
+InitialCache::InitialCache(const std::string& packages, const fs::path& cachedir, bool retry) {
+    if (cachedir.empty()) {
+        return;
+    }
+    const auto toolchain{toolchainDigest(cachedir)};
+    if (toolchain.empty()) {
+        return;
+    }
+    const auto cmake{Tool::shared("cmake", cachedir)};
+    const auto dir{cachedir / ("cmake-" + hexDigest(fnv1a(packages, fnv1a("\n", fnv1a(toolchain)))))};
+    const auto candidate{dir / cacheName};
+    std::error_code ec;
+    if (fs::exists(dir / failedName, ec)) {
+        const auto age{fs::file_time_type::clock::now() - fs::last_write_time(dir / failedName, ec)};
+        if (!retry && !ec && age < retryAfter) {
+            return;
+        }
+        fs::remove(dir / failedName, ec);
+    }
+    if (!fs::exists(candidate, ec)) {
+        // each probe has a directory of its own, so that concurrent runs do not configure the same one
+        const auto probe{dir / ("probe-" + uniqueSuffix())};
+        const auto builddir{probe / "build"};
+        fs::create_directories(probe, ec);
+        std::ofstream{probe / "CMakeLists.txt"} << probeCommands(packages);
+        const auto command{shellQuoted(cmake->path) + " -S " + shellQuoted(probe) + " -B " + shellQuoted(builddir)
+            + " > " + shellQuoted(probe / "probe.log") + " 2>&1"};
+        std::string compilers;
+        if (!ec && runCommand(command, probe).status == 0) {
+            compilers = compilerSettings(builddir);
+        }
+        if (compilers.empty()) {
+            fs::rename(probe / logName, dir / logName, ec);
+            fs::remove_all(probe, ec);
+            std::ofstream{dir / failedName};
+            std::cerr << "Warning: CMake could not probe the toolchain, so projects are configured without an initial cache; see "
+                << (dir / logName).string() << '\n';
+            return;
+        }
+        const bool replaced{replaceFile(candidate, [&](const fs::path& tmpfile) {
+            std::ofstream out{tmpfile, std::ios::binary};
+            out << "# initial cache for " << cmake->version << ", written by autoproject\n"
+                << "# use it with cmake -C, or include it ahead of the first project()\n"
+                << compilers << packageSettings(builddir / "CMakeCache.txt");
+            out.close();
+            return static_cast<bool>(out);
+        })};
+        fs::remove_all(probe, ec);
+        if (!replaced) {
+            return;
+        }
+    }
+    file = candidate;
+}
+
+std::shared_ptr<const InitialCache> InitialCache::shared(const std::string& packages, const fs::path& cachedir, bool retry) {
+    static std::mutex mtx;
+    static std::map<std::string, std::shared_ptr<const InitialCache>> made;
+    // held while probing, so that the other threads of a batch wait for the one probe rather than each running it
+    std::lock_guard<std::mutex> lock{mtx};
+    auto& result{made[cachedir.string() + '\n' + packages]};
+    if (!result) {
+        result = std::make_shared<const InitialCache>(packages, cachedir, retry);
+    }
+    // one that could not be made is remembered too, so that it is only tried once
+    return result->file.empty() ? nullptr : result;
+}
+
+std::string InitialCache::toolchainDigest(const fs::path& cachedir) {
+    const auto cmake{Tool::shared("cmake", cachedir)};
+    if (!cmake) {
+        return {};
+    }
+    // CMake chooses the compilers named by CC and CXX, or else these
+    std::uint64_t hash{fnv1a(cmake->digest())};
+    for (const auto& name : { compilerName("CC", "cc"), compilerName("CXX", "c++") }) {
+        const auto compiler{Tool::shared(name, cachedir)};
+        hash = fnv1a(compiler ? compiler->digest() : name, fnv1a("\n", hash));
+    }
+    return hexDigest(hash);
+}
+
+/*! The probe enables C and C++ and runs each of `packages`, with any
+ * REQUIRED turned into QUIET, so that a package that is not installed
+ * is simply not found.
+ */
+std::string InitialCache::probeCommands(const std::string& packages) {
+    static const std::regex required{R"(\s+REQUIRED\b)"};
+    std::string text{"cmake_minimum_required(VERSION 3.16)\nproject(autoproject_probe C CXX)\n"};
+    std::istringstream in{packages};
+    for (std::string line; std::getline(in, line); ) {
+        line = std::regex_replace(line, required, "");
+        if (const auto end{line.rfind(')')}; end != std::string::npos) {
+            text += line.substr(0, end) + " QUIET" + line.substr(end) + '\n';
+        }
+    }
+    return text;
+}
+
+// helper functions
+
+/// the compiler named by the environment `variable`, as CMake chooses it, or else `fallback`
+std::string compilerName(const char *variable, const char *fallback) {
+    const char *name{std::getenv(variable)};
+    return name && *name ? name : fallback;
+}
+
+/*! What CMake found out about each compiler, from the files it keeps
+ * under CMakeFiles/<version> in `builddir`, as cache entries.
+ *
+ * Marking each compiler as forced and identified then stops CMake from
+ * doing it all again.  Only the unconditional settings, those at the
+ * start of a line, are needed; the rest follow from them.
+ */
+std::string compilerSettings(const fs::path& builddir) {
+    static const std::regex setting{R"(^set\((\w+) (.*)\)$)"};
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(builddir / "CMakeFiles", ec)) {
+        if (!fs::exists(entry.path() / "CMakeCXXCompiler.cmake", ec)) {
+            continue;
+        }
+        std::string text;
+        for (const std::string lang : { "C", "CXX" }) {
+            std::ifstream in{entry.path() / ("CMake" + lang + "Compiler.cmake")};
+            if (!in) {
+                return {};
+            }
+            for (std::string line; std::getline(in, line); ) {
+                std::smatch match;
+                if (std::regex_match(line, match, setting)) {
+                    text += "set(" + match.str(1) + ' ' + match.str(2) + " CACHE INTERNAL \"\")\n";
+                }
+            }
+            text += "set(CMAKE_" + lang + "_COMPILER_FORCED TRUE CACHE INTERNAL \"\")\n"
+                "set(CMAKE_" + lang + "_COMPILER_ID_RUN TRUE CACHE INTERNAL \"\")\n";
+        }
+        return text;
+    }
+    return {};
+}
+
+/*! The locations found by the probe's find_package commands, and the
+ * results of the checks they made, as cache entries.
+ *
+ * CMake's own settings and the probe project's are left out, and so is
+ * anything that was not found, so that a project still looks for it.
+ */
+std::string packageSettings(const fs::path& cachefile) {
+    static const std::regex entry{R"(^([A-Za-z_][\w.+-]*):(PATH|FILEPATH|STRING|INTERNAL)=(.+)$)"};
+    static constexpr std::string_view notFound{"-NOTFOUND"};
+    std::ifstream in{cachefile};
+    std::string text;
+    for (std::string line; std::getline(in, line); ) {
+        std::smatch match;
+        if (!std::regex_match(line, match, entry)) {
+            continue;
+        }
+        const auto name{match.str(1)};
+        const auto type{match.str(2)};
+        const auto value{match.str(3)};
+        const bool check{type == "INTERNAL" && name.rfind("CMAKE_HAVE_", 0) == 0};
+        const bool found{type != "INTERNAL" && name.rfind("CMAKE_", 0) != 0 && name.rfind("autoproject_probe_", 0) != 0
+            && (value.size() < notFound.size() || value.compare(value.size() - notFound.size(), notFound.size(), notFound) != 0)};
+        if (check || found) {
+            text += "set(" + name + ' ' + cacheValue(value) + " CACHE " + type + " \"\")\n";
+        }
+    }
+    return text;
+}
+
+/// `value` as a quoted CMake argument
+std::string cacheValue(std::string_view value) {
+    std::string quoted{"\""};
+    for (const char ch : value) {
+        if (ch == '\\' || ch == '"' || ch == '$') {
+            quoted += '\\';
+        }
+        quoted += ch;
+    }
+    return quoted + '"';
+}
@@ -0,0 +1,51 @@
+#ifndef INITIALCACHE_H
+#define INITIALCACHE_H
+#include "config.h"
+#include <memory>
+#include <string>
+
+#if HAS_FILESYSTEM
+#include <filesystem>
+namespace fs = std::filesystem;
+#else
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#endif
+
+/*! An initial cache for `cmake -C`, holding what configuring any project
+ * with this toolchain would otherwise find out afresh.
+ *
+ * Most of the time CMake takes to configure a small project goes on
+ * identifying the compilers and then on the searches of each
+ * find_package.  Both give the same answers for every project, so a
+ * probe project is configured once and what it found is written to
+ * `initial-cache.cmake` in the cache directory, in a directory named for
+ * the digest of CMake, the C and C++ compilers it chooses and the
+ * packages.  The compilers are then marked as already identified and
+ * tested, and each package location the probe found is set in advance.
+ *
+ * The file works as the script of `cmake -C` and also as a file included
+ * ahead of the first project() command, e.g. with
+ * CMAKE_PROJECT_INCLUDE_BEFORE.
+ */
+class InitialCache {
+public:
+    /*! probe the toolchain and `packages`, the find_package commands one
+     * per line, unless that is already in `cachedir`.
+     *
+     * If CMake cannot be found or the probe fails, `file` is empty.  A
+     * failed probe leaves its log beside a marker that stops it being
+     * tried again for a day, or until it is asked to `retry`.
+     */
+    InitialCache(const std::string& packages, const fs::path& cachedir, bool retry = false);
+    /// the initial cache for these arguments, made on first use and shared thereafter; nullptr if it cannot be made
+    static std::shared_ptr<const InitialCache> shared(const std::string& packages, const fs::path& cachedir, bool retry = false);
+    /// the digest of CMake and of the C and C++ compilers it would choose; empty if CMake cannot be found
+    static std::string toolchainDigest(const fs::path& cachedir);
+    /// a CMakeLists.txt that enables C and C++ and looks for each of `packages`, but requires none of them
+    static std::string probeCommands(const std::string& packages);
+
+    /// the initial cache script
+    fs::path file;
+};
+#endif // INITIALCACHE_H
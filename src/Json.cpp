@@ -0,0 +1,367 @@
+#include "Json.h"
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+
+// local constants
+// arrays and objects nested deeper than this are rejected rather than exhausting the stack
+static constexpr unsigned maxDepth{128};
+
+// helper functions
+namespace {
+class Parser {
+public:
+    Parser(std::string_view text) : text{text} {}
+
+    Json document() {
+        Json value{parseValue()};
+        skipSpace();
+        if (pos != text.size()) {
+            fail("unexpected trailing characters");
+        }
+        return value;
+    }
+
+private:
+    [[noreturn]] void fail(const std::string& msg) const {
+        throw JsonError("JSON error at offset " + std::to_string(pos) + ": " + msg);
+    }
+
+    void skipSpace() {
+        while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r')) {
+            ++pos;
+        }
+    }
+
+    void expect(char ch) {
+        skipSpace();
+        if (pos >= text.size() || text[pos] != ch) {
+            fail(std::string("expected '") + ch + "'");
+        }
+        ++pos;
+    }
+
+    /// note one more level of nesting, failing if there are too many
+    void nest() {
+        if (++depth > maxDepth) {
+            fail("nested too deeply");
+        }
+    }
+
+    bool consume(std::string_view word) {
+        if (text.substr(pos, word.size()) == word) {
+            pos += word.size();
+            return true;
+        }
+        return false;
+    }
+
+    Json parseValue() {
+        skipSpace();
+        if (pos >= text.size()) {
+            fail("unexpected end of input");
+        }
+        switch (text[pos]) {
+            case '{':
+                return parseObject();
+            case '[':
+                return parseArray();
+            case '"':
+                return parseString();
+            default:
+                break;
+        }
+        if (consume("true")) {
+            return true;
+        }
+        if (consume("false")) {
+            return false;
+        }
+        if (consume("null")) {
+            return Json{};
+        }
+        return parseNumber();
+    }
+
+    Json parseObject() {
+        Json obj{Json::object()};
+        expect('{');
+        nest();
+        skipSpace();
+        if (pos < text.size() && text[pos] == '}') {
+            ++pos;
+            --depth;
+            return obj;
+        }
+        do {
+            skipSpace();
+            std::string key{parseString().asString()};
+            expect(':');
+            obj.set(key, parseValue());
+            skipSpace();
+        } while (pos < text.size() && text[pos] == ',' && ++pos);
+        expect('}');
+        --depth;
+        return obj;
+    }
+
+    Json parseArray() {
+        Json arr{Json::array()};
+        expect('[');
+        nest();
+        skipSpace();
+        if (pos < text.size() && text[pos] == ']') {
+            ++pos;
+            --depth;
+            return arr;
+        }
+        do {
+            arr.push_back(parseValue());
+            skipSpace();
+        } while (pos < text.size() && text[pos] == ',' && ++pos);
+        expect(']');
+        --depth;
+        return arr;
+    }
+
+    unsigned hex4() {
+        if (pos + 4 > text.size()) {
+            fail("truncated \\u escape");
+        }
+        unsigned value{0};
+        for (int i{0}; i < 4; ++i) {
+            char ch{text[pos++]};
+            value <<= 4;
+            if (ch >= '0' && ch <= '9') {
+                value |= ch - '0';
+            } else if (ch >= 'a' && ch <= 'f') {
+                value |= ch - 'a' + 10;
+            } else if (ch >= 'A' && ch <= 'F') {
+                value |= ch - 'A' + 10;
+            } else {
+                fail("bad \\u escape");
+            }
+        }
+        return value;
+    }
+
+    static void appendUtf8(std::string& out, unsigned cp) {
+        if (cp < 0x80) {
+            out += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            out += static_cast<char>(0xC0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            out += static_cast<char>(0xE0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (cp >> 18));
+            out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+
+    Json parseString() {
+        expect('"');
+        std::string str;
+        while (pos < text.size() && text[pos] != '"') {
+            char ch{text[pos++]};
+            if (ch != '\\') {
+                str += ch;
+                continue;
+            }
+            if (pos >= text.size()) {
+                break;
+            }
+            switch (text[pos++]) {
+                case '"': str += '"'; break;
+                case '\\': str += '\\'; break;
+                case '/': str += '/'; break;
+                case 'b': str += '\b'; break;
+                case 'f': str += '\f'; break;
+                case 'n': str += '\n'; break;
+                case 'r': str += '\r'; break;
+                case 't': str += '\t'; break;
+                case 'u': {
+                    unsigned cp{hex4()};
+                    // combine a UTF-16 surrogate pair
+                    if (cp >= 0xD800 && cp < 0xDC00 && consume("\\u")) {
+                        unsigned low{hex4()};
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    appendUtf8(str, cp);
+                    break;
+                }
+                default:
+                    fail("bad escape sequence");
+            }
+        }
+        if (pos >= text.size()) {
+            fail("unterminated string");
+        }
+        ++pos;
+        return str;
+    }
+
+    Json parseNumber() {
+        std::size_t start{pos};
+        while (pos < text.size() && (std::isdigit(static_cast<unsigned char>(text[pos])) || text[pos] == '-' || text[pos] == '+'
+                    || text[pos] == '.' || text[pos] == 'e' || text[pos] == 'E')) {
+            ++pos;
+        }
+        if (start == pos) {
+            fail("unexpected character");
+        }
+        std::istringstream in{std::string{text.substr(start, pos - start)}};
+        double value;
+        if (!(in >> value)) {
+            fail("malformed number");
+        }
+        return value;
+    }
+
+    std::string_view text;
+    std::size_t pos{0};
+    // how many arrays and objects enclose the current position
+    unsigned depth{0};
+};
+
+void quote(std::ostream& out, const std::string& str) {
+    out << '"';
+    for (unsigned char ch : str) {
+        switch (ch) {
+            case '"': out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\n': out << "\\n"; break;
+            case '\r': out << "\\r"; break;
+            case '\t': out << "\\t"; break;
+            default:
+                if (ch < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof buf, "\\u%04x", ch);
+                    out << buf;
+                } else {
+                    out << ch;
+                }
+        }
+    }
+    out << '"';
+}
+}
+
+Json Json::parse(std::string_view text) {
+    return Parser{text}.document();
+}
+
+double Json::asNumber() const {
+    if (kind == Type::number) {
+        return number;
+    }
+    if (kind == Type::string) {
+        try {
+            return std::stod(text);
+        }
+        catch (std::exception&) {
+        }
+    }
+    return 0;
+}
+
+std::string Json::asString() const {
+    if (kind == Type::number) {
+        std::stringstream ss;
+        ss << *this;
+        return ss.str();
+    }
+    return text;
+}
+
+bool Json::has(const std::string& key) const {
+    for (const auto& field : fields) {
+        if (field.first == key) {
+            return true;
+        }
+    }
+    return false;
+}
+
+const Json& Json::operator[](const std::string& key) const {
+    static const Json null;
+    for (const auto& field : fields) {
+        if (field.first == key) {
+            return field.second;
+        }
+    }
+    return null;
+}
+
+Json& Json::set(const std::string& key, Json value) {
+    kind = Type::object;
+    for (auto& field : fields) {
+        if (field.first == key) {
+            field.second = std::move(value);
+            return *this;
+        }
+    }
+    fields.emplace_back(key, std::move(value));
+    return *this;
+}
+
+Json& Json::push_back(Json value) {
+    kind = Type::array;
+    elements.push_back(std::move(value));
+    return *this;
+}
+
+std::string Json::dump() const {
+    std::stringstream ss;
+    ss << *this;
+    return ss.str();
+}
+
+std::ostream& operator<<(std::ostream& out, const Json& json) {
+    switch (json.kind) {
+        case Json::Type::null:
+            out << "null";
+            break;
+        case Json::Type::boolean:
+            out << (json.boolean ? "true" : "false");
+            break;
+        case Json::Type::number:
+            if (std::isfinite(json.number) && json.number == std::floor(json.number) && std::fabs(json.number) < 1e15) {
+                out << static_cast<long long>(json.number);
+            } else {
+                out << json.number;
+            }
+            break;
+        case Json::Type::string:
+            quote(out, json.text);
+            break;
+        case Json::Type::array: {
+            out << '[';
+            const char *sep{""};
+            for (const auto& item : json.elements) {
+                out << sep << item;
+                sep = ",";
+            }
+            out << ']';
+            break;
+        }
+        case Json::Type::object: {
+            out << '{';
+            const char *sep{""};
+            for (const auto& field : json.fields) {
+                out << sep;
+                quote(out, field.first);
+                out << ':' << field.second;
+                sep = ",";
+            }
+            out << '}';
+            break;
+        }
+    }
+    return out;
+}
@@ -0,0 +1,69 @@
+#ifndef JSON_H
+#define JSON_H
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class JsonError : public std::runtime_error
+{
+public:
+    JsonError(const std::string& msg) :
+        std::runtime_error(msg)
+    {}
+};
+
+/*! A minimal JSON value.
+ *
+ * This is just enough JSON to exchange small request and result
+ * messages with other processes.  Object members keep their insertion
+ * order so that serialized output is predictable.
+ */
+class Json
+{
+public:
+    enum class Type { null, boolean, number, string, array, object };
+    using Object = std::vector<std::pair<std::string, Json>>;
+
+    Json() = default;
+    Json(bool value) : kind{Type::boolean}, boolean{value} {}
+    template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, bool>>>
+    Json(T value) : kind{Type::number}, number{static_cast<double>(value)} {}
+    Json(std::string value) : kind{Type::string}, text{std::move(value)} {}
+    Json(const char *value) : kind{Type::string}, text{value} {}
+    static Json array() { Json j; j.kind = Type::array; return j; }
+    static Json object() { Json j; j.kind = Type::object; return j; }
+    /// parse `text` as a single JSON value; throws JsonError if malformed
+    static Json parse(std::string_view text);
+
+    Type type() const { return kind; }
+    bool isNull() const { return kind == Type::null; }
+    bool isString() const { return kind == Type::string; }
+    /// the value as a bool; null and non-boolean values yield `fallback`
+    bool asBool(bool fallback = false) const { return kind == Type::boolean ? boolean : fallback; }
+    double asNumber() const;
+    /// the string value or, for numbers, the number formatted as text
+    std::string asString() const;
+    const std::vector<Json>& items() const { return elements; }
+    const Object& members() const { return fields; }
+    bool has(const std::string& key) const;
+    /// the member named `key` or null if it does not exist
+    const Json& operator[](const std::string& key) const;
+    /// add or replace the member named `key`
+    Json& set(const std::string& key, Json value);
+    Json& push_back(Json value);
+    std::string dump() const;
+    friend std::ostream& operator<<(std::ostream& out, const Json& json);
+
+private:
+    Type kind = Type::null;
+    bool boolean = false;
+    double number = 0;
+    std::string text;
+    std::vector<Json> elements;
+    Object fields;
+};
+#endif // JSON_H
@@ -0,0 +1,103 @@
+#include "MappedFile.h"
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std::literals;
+
+MappedFile::MappedFile(const fs::path& filename) {
+    std::string contents;
+#ifndef _WIN32
+    int fd{::open(filename.c_str(), O_RDONLY)};
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open input file "s + filename.string());
+    }
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+        size = static_cast<std::size_t>(info.st_size);
+        if (size == 0) {
+            ::close(fd);
+            return;
+        }
+        void *addr{mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0)};
+        if (addr != MAP_FAILED) {
+            ::close(fd);
+            data = static_cast<const char *>(addr);
+            mapped = true;
+            return;
+        }
+        size = 0;
+    }
+    // not mappable, e.g. a pipe, which is read through the descriptor already open since opening it again would wait for another writer
+    char chunk[65536];
+    for (;;) {
+        const auto got{::read(fd, chunk, sizeof chunk)};
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0) {
+            ::close(fd);
+            throw std::runtime_error("Cannot read input file "s + filename.string());
+        }
+        if (got == 0) {
+            break;
+        }
+        contents.append(chunk, static_cast<std::size_t>(got));
+    }
+    ::close(fd);
+#else
+    std::ifstream in{filename, std::ios::binary};
+    if (!in) {
+        throw std::runtime_error("Cannot open input file "s + filename.string());
+    }
+    contents.assign(std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{});
+#endif
+    size = contents.size();
+    buffer = std::make_unique<char[]>(size);
+    contents.copy(buffer.get(), size);
+    data = buffer.get();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept :
+    data{std::exchange(other.data, nullptr)},
+    size{std::exchange(other.size, 0)},
+    mapped{std::exchange(other.mapped, false)},
+    buffer{std::move(other.buffer)}
+{}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        release();
+        data = std::exchange(other.data, nullptr);
+        size = std::exchange(other.size, 0);
+        mapped = std::exchange(other.mapped, false);
+        buffer = std::move(other.buffer);
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile() {
+    release();
+}
+
+void MappedFile::release() {
+#ifndef _WIN32
+    if (mapped) {
+        munmap(const_cast<char *>(data), size);
+    }
+#endif
+    mapped = false;
+    data = nullptr;
+    size = 0;
+    buffer.reset();
+}
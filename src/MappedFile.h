@@ -0,0 +1,43 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+#include "config.h"
+#include <cstddef>
+#include <memory>
+#include <string_view>
+
+#if HAS_FILESYSTEM
+#include <filesystem>
+namespace fs = std::filesystem;
+#else
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#endif
+
+/*! Read-only view of the entire contents of a file.
+ *
+ * Where the platform supports it, the file is memory mapped so that no
+ * copy of the contents is ever made; elsewhere it is read into a single
+ * heap buffer.  The view remains valid as long as the object lives,
+ * including across moves.
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+    /// map `filename`; throws std::runtime_error if it cannot be read
+    explicit MappedFile(const fs::path& filename);
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+    std::string_view view() const { return {data, size}; }
+
+private:
+    void release();
+
+    const char *data = nullptr;
+    std::size_t size = 0;
+    bool mapped = false;
+    std::unique_ptr<char[]> buffer;
+};
+#endif // MAPPEDFILE_H
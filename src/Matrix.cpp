@@ -0,0 +1,106 @@
+#include "config.h"
+#include "Matrix.h"
+#include "CMakeBuild.h"
+#include "Tool.h"
+#include "WorkPool.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+
+namespace {
+/// one compiler and optimization level, and how it went
+struct Combination {
+    std::shared_ptr<const Tool> compiler;
+    std::string level;
+    fs::path builddir;
+    std::chrono::duration<double> buildTime{};
+    std::uintmax_t size = 0;
+    std::chrono::duration<double> runTime{};
+    // why it could not be built or run, if it could not
+    std::string error;
+};
+}
+
+int runMatrix(const AutoProject& ap, const std::vector<std::string>& compilers, const std::vector<std::string>& levels, const std::string& args, unsigned jobs, std::ostream& out) {
+    std::unique_ptr<const CMakeBuild> project;
+    try {
+        project = std::make_unique<const CMakeBuild>(ap, args);
+    }
+    catch(std::exception& e) {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+    const std::string lang{ap.language() == "c" ? "C" : "CXX"};
+    std::vector<Combination> matrix;
+    for (const auto& name : compilers) {
+        const auto compiler{Tool::shared(name)};
+        if (!compiler) {
+            out << "Compiler " << name << " was not found\n";
+            continue;
+        }
+        for (const auto& level : levels) {
+            const auto label{level.substr(std::min(level.find_first_not_of('-'), level.size()))};
+            Combination combination;
+            combination.compiler = compiler;
+            combination.level = level;
+            combination.builddir = project->projectDir() / ("matrix-" + compiler->path.filename().string() + '-' + label);
+            matrix.push_back(combination);
+        }
+    }
+    if (matrix.empty()) {
+        std::cerr << "Error: there is nothing to build\n";
+        return 1;
+    }
+
+    out << "Building " << matrix.size() << " configurations\n";
+    {
+        WorkPool pool{jobs};
+        for (auto& combination : matrix) {
+            pool.submit([&]{
+                try {
+                    project->configure(combination.builddir, {
+                        "CMAKE_" + lang + "_COMPILER=" + combination.compiler->path.string(),
+                        "CMAKE_" + lang + "_FLAGS=" + combination.level,
+                        "CMAKE_BUILD_TYPE=",
+                        "AUTOPROJECT_PROFILE=none",
+                        "AUTOPROJECT_PGO=",
+                    });
+                    combination.buildTime = project->build(combination.builddir);
+                    combination.size = fs::file_size(project->program(combination.builddir));
+                }
+                catch(std::exception& e) {
+                    combination.error = e.what();
+                }
+            });
+        }
+        pool.wait();
+    }
+    // the programs are run one at a time, so that they do not compete for the processor
+    out << "Running each with: " << project->arguments() << "\n\n";
+    for (auto& combination : matrix) {
+        if (combination.error.empty()) {
+            try {
+                combination.runTime = project->bestTime(combination.builddir);
+            }
+            catch(std::exception& e) {
+                combination.error = e.what();
+            }
+        }
+    }
+
+    int status{0};
+    out << std::left << std::setw(32) << "configuration" << std::right << std::setw(10) << "build s"
+        << std::setw(12) << "size" << std::setw(10) << "run s" << '\n';
+    for (const auto& combination : matrix) {
+        out << std::left << std::setw(32) << combination.builddir.filename().string() << std::right;
+        if (combination.error.empty()) {
+            out << std::fixed << std::setprecision(3) << std::setw(10) << combination.buildTime.count()
+                << std::setw(12) << combination.size << std::setw(10) << combination.runTime.count() << '\n';
+        } else {
+            out << "  failed: " << combination.error << '\n';
+            status = 1;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,23 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+#include "AutoProject.h"
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*! Build the project `ap` has created with each of `compilers` at each
+ * of the optimization `levels`, e.g. "-O2", and compare the results.
+ *
+ * Each combination is configured with CMake in a directory of its own,
+ * such as `matrix-g++-O2`, with the level as the only compile flags
+ * beyond those of the project, so any optimization profile is turned
+ * off there.  The combinations are built in parallel on `jobs` threads,
+ * and each program is then run in turn with the arguments `args`, as
+ * described for CMakeBuild.  A table of the build time, program size
+ * and best runtime of each is printed to `out`.  Compilers that cannot
+ * be found are left out.
+ *
+ * @return the process exit status, which is 0 only if every combination built and ran
+ */
+int runMatrix(const AutoProject& ap, const std::vector<std::string>& compilers, const std::vector<std::string>& levels, const std::string& args, unsigned jobs, std::ostream& out);
+#endif // MATRIX_H
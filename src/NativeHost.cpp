@@ -0,0 +1,131 @@
+#include "config.h"
+#include "NativeHost.h"
+#include "Server.h"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+// local constants
+// the largest message a browser sends to a native host; a longer length means the framing is lost
+static constexpr std::uint32_t maxMessage{64 * 1024 * 1024};
+
+// helper functions
+namespace {
+// the subset of HTML character references the StackExchange API produces
+std::string htmlUnescape(std::string_view text) {
+    static const std::map<std::string_view, std::string_view> entities{
+        {"amp", "&"}, {"lt", "<"}, {"gt", ">"}, {"quot", "\""}, {"apos", "'"}, {"nbsp", "\xc2\xa0"},
+    };
+    std::string result;
+    result.reserve(text.size());
+    for (std::size_t i{0}; i < text.size(); ++i) {
+        auto semi{text[i] == '&' ? text.find(';', i) : std::string_view::npos};
+        if (semi == std::string_view::npos || semi - i > 10) {
+            result += text[i];
+            continue;
+        }
+        auto name{text.substr(i + 1, semi - i - 1)};
+        if (name.size() > 1 && name[0] == '#') {
+            char *end;
+            std::string digits{name.substr(1)};
+            bool hex{digits[0] == 'x' || digits[0] == 'X'};
+            unsigned long cp{std::strtoul(digits.c_str() + hex, &end, hex ? 16 : 10)};
+            if (*end == '\0' && cp > 0 && cp < 0x110000) {
+                // encode as UTF-8
+                if (cp < 0x80) {
+                    result += static_cast<char>(cp);
+                } else if (cp < 0x800) {
+                    result += static_cast<char>(0xC0 | (cp >> 6));
+                    result += static_cast<char>(0x80 | (cp & 0x3F));
+                } else if (cp < 0x10000) {
+                    result += static_cast<char>(0xE0 | (cp >> 12));
+                    result += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                    result += static_cast<char>(0x80 | (cp & 0x3F));
+                } else {
+                    result += static_cast<char>(0xF0 | (cp >> 18));
+                    result += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+                    result += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                    result += static_cast<char>(0x80 | (cp & 0x3F));
+                }
+                i = semi;
+                continue;
+            }
+        } else if (auto entity{entities.find(name)}; entity != entities.end()) {
+            result += entity->second;
+            i = semi;
+            continue;
+        }
+        result += text[i];
+    }
+    return result;
+}
+
+bool readMessage(std::istream& in, std::string& message) {
+    std::uint32_t length;
+    if (!in.read(reinterpret_cast<char *>(&length), sizeof length)) {
+        return false;
+    }
+    if (length > maxMessage) {
+        std::cerr << "Error: native message of " << length << " bytes is too long\n";
+        return false;
+    }
+    message.resize(length);
+    return static_cast<bool>(in.read(message.data(), length));
+}
+
+void sendMessage(std::ostream& out, const Json& message) {
+    const auto content{message.dump()};
+    const auto length{static_cast<std::uint32_t>(content.size())};
+    out.write(reinterpret_cast<const char *>(&length), sizeof length);
+    out << content;
+    out.flush();
+}
+}
+
+std::string questionMarkdown(const Json& question) {
+    // tags are written the way Python prints a list: ['c++', 'beginner']
+    std::string tags{"["};
+    for (const auto& tag : question["tags"].items()) {
+        if (tags.size() > 1) {
+            tags += ", ";
+        }
+        tags += "'" + tag.asString() + "'";
+    }
+    tags += "]";
+    std::string md{"# [" + htmlUnescape(question["title"].asString()) + "](https://codereview.stackexchange.com/questions/"
+        + question["question_id"].asString() + ")\n### tags: " + tags + "\n\n"};
+    const auto body{htmlUnescape(question["body_markdown"].asString())};
+    md.reserve(md.size() + body.size());
+    for (std::size_t i{0}; i < body.size(); ++i) {
+        if (body[i] != '\r' || i + 1 >= body.size() || body[i + 1] != '\n') {
+            md += body[i];
+        }
+    }
+    return md;
+}
+
+int runNativeHost(std::istream& in, std::ostream& out, bool overwrite, const std::map<std::string, LangConfig>& lang) {
+    const char *dir{std::getenv("AUTOPROJECT_DIR")};
+    const fs::path basedir{dir ? dir : "/tmp"};
+    for (std::string message; readMessage(in, message); ) {
+        Json result{Json::object()};
+        try {
+            const auto question{Json::parse(message)};
+            const auto qnumber{question["question_id"].asString()};
+            if (qnumber.empty() || qnumber.find_first_of("/\\.") != std::string::npos) {
+                throw std::runtime_error("message has no valid \"question_id\"");
+            }
+            Json request{Json::object()};
+            request.set("name", (basedir / (qnumber + ".md")).string());
+            request.set("content", questionMarkdown(question));
+            result = handleRequest(request, overwrite, lang);
+            result.set("question_id", qnumber);
+        }
+        catch (std::exception& e) {
+            result.set("ok", false);
+            result.set("error", e.what());
+        }
+        sendMessage(out, result);
+    }
+    return 0;
+}
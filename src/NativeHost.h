@@ -0,0 +1,31 @@
+#ifndef NATIVEHOST_H
+#define NATIVEHOST_H
+#include "AutoProject.h"
+#include "Json.h"
+#include <iostream>
+#include <map>
+#include <string>
+#include <string_view>
+
+/// the id of the companion browser extension
+static constexpr std::string_view extensionId{"autoproject@beroset.com"};
+
+/*! Build the markdown for a question as `fetchQ` does.
+ *
+ * `question` is an item as returned by the StackExchange API and must
+ * have `question_id`, `title`, `tags` and `body_markdown` fields.
+ */
+std::string questionMarkdown(const Json& question);
+
+/*! Act as the browser's native messaging host.
+ *
+ * Each message on `in` is a 32-bit length in native byte order followed
+ * by that many bytes of JSON describing a question.  The question is
+ * extracted straight from memory into `$AUTOPROJECT_DIR` (default `/tmp`)
+ * and the result is sent back on `out` using the same framing.  Returns
+ * when `in` is exhausted.
+ *
+ * @return the process exit status
+ */
+int runNativeHost(std::istream& in, std::ostream& out, bool overwrite, const std::map<std::string, LangConfig>& lang);
+#endif // NATIVEHOST_H
@@ -0,0 +1,582 @@
+#include "ObjectCache.h"
+#include "Hash.h"
+#include "MappedFile.h"
+#include "Process.h"
+#include "Tool.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string_view>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+// local constants
+static constexpr std::string_view manifestTag{"autoproject object manifest"};
+static const fs::path statsName{"stats"};
+// locked by whoever changes a manifest, so that concurrent compiles do not lose each other's entries
+static const fs::path lockName{"lock"};
+// the most entries a manifest keeps, most recently used first, so that it cannot grow without end
+static constexpr std::size_t manifestLimit{16};
+
+namespace {
+/// a compile command taken apart
+struct Command {
+    std::string compiler;
+    // every argument that can change the object, in order
+    std::vector<std::string> flags;
+    std::string source;
+    std::string object;
+    // the dependency file the command asks for, if any, with its targets
+    std::string depfile;
+    std::vector<std::string> targets;
+    bool phony = false;
+    // files named by -include, which a precompiled header hides from the dependency output
+    std::vector<std::string> includes;
+    bool debug = false;
+};
+
+/// what the cache needs to know of an input file
+struct Contents {
+    std::string digest;
+    // it mentions __FILE__, so the object depends on the path the source is given by
+    bool file = false;
+    // it mentions the date or time, so the object is never the same twice
+    bool time = false;
+};
+
+/// a header that an earlier compile included
+struct Header {
+    std::string digest;
+    std::uintmax_t size = 0;
+    long long time = 0;
+    // `path` is relative to the directory of the source rather than absolute
+    bool local = false;
+    fs::path path;
+};
+
+/*! An exclusive lock on the manifests in a directory, held while one is
+ * read, changed and written back.  On Windows there is no lock.
+ */
+class ManifestLock {
+public:
+    explicit ManifestLock(const fs::path& dir) {
+#ifndef _WIN32
+        fd = ::open((dir / lockName).c_str(), O_RDWR | O_CREAT, 0666);
+        if (fd >= 0 && flock(fd, LOCK_EX) != 0) {
+            ::close(fd);
+            fd = -1;
+        }
+#else
+        static_cast<void>(dir);
+#endif
+    }
+    ManifestLock(const ManifestLock&) = delete;
+    ManifestLock& operator=(const ManifestLock&) = delete;
+    ~ManifestLock() {
+#ifndef _WIN32
+        if (fd >= 0) {
+            ::close(fd);
+        }
+#endif
+    }
+
+private:
+    int fd = -1;
+};
+
+/// an earlier compile of the same source with the same compiler and flags
+struct Entry {
+    std::string object;
+    // the source argument and working directory that the object depends on, if any
+    std::string source;
+    std::string directory;
+    std::vector<Header> headers;
+};
+}
+
+// helper functions
+static bool parse(const std::vector<std::string>& args, Command& command);
+static bool examine(const fs::path& filename, Contents& contents);
+static long long modified(const fs::path& filename, std::error_code& ec);
+static bool matches(const Entry& entry, const Command& command, const fs::path& cwd, std::vector<std::string>& named);
+static std::vector<Entry> readManifest(const fs::path& filename);
+static void writeManifest(const fs::path& filename, const std::vector<Entry>& entries);
+static void promote(const fs::path& filename, const std::string& object);
+static std::vector<std::string> dependencies(const fs::path& depfile);
+static void writeDependencies(const Command& command, const std::vector<std::string>& inputs);
+static std::string escaped(const std::string& name);
+static std::string commandLine(const std::vector<std::string>& args);
+static void count(const fs::path& dir, bool hit);
+
+// ObjectCache interface functions
+ObjectCache::ObjectCache(const fs::path& cachedir) :
+    dir{cachedir / "objects"},
+    cachedir{cachedir}
+{}
+
+/*! On a miss, the command is run with its own dependency options
+ * replaced by `-MD -MF` of a file of the cache's own, which lists every
+ * header, system headers included, and the diagnostics are kept with
+ * the object so that a hit shows them too.
+ */
+int ObjectCache::compile(const std::vector<std::string>& args) const {
+    const auto cwd{fs::current_path()};
+    Command command;
+    std::shared_ptr<const Tool> compiler;
+    Contents source;
+    if (!parse(args, command) || !(compiler = Tool::shared(command.compiler, cachedir)) || !examine(command.source, source)) {
+        const auto result{runCommand(commandLine(args), cwd)};
+        return result.status < 0 ? 1 : result.status;
+    }
+    std::uint64_t hash{fnv1a(compiler->digest(), fnv1a("\n", fnv1a(source.digest)))};
+    for (const auto& flag : command.flags) {
+        hash = fnv1a(flag, fnv1a("\n", hash));
+    }
+    const auto manifest{dir / (hexDigest(hash) + ".manifest")};
+    std::error_code ec;
+    const auto known{readManifest(manifest)};
+    for (const auto& entry : known) {
+        std::vector<std::string> inputs{command.source};
+        if (!matches(entry, command, cwd, inputs)) {
+            continue;
+        }
+        fs::copy_file(dir / (entry.object + ".o"), command.object, fs::copy_options::overwrite_existing, ec);
+        if (!ec) {
+            std::cerr << std::ifstream{dir / (entry.object + ".stderr"), std::ios::binary}.rdbuf() << std::flush;
+            writeDependencies(command, inputs);
+            if (&entry != &known.front()) {
+                promote(manifest, entry.object);
+            }
+            count(dir, true);
+            return 0;
+        }
+    }
+
+    count(dir, false);
+    fs::create_directories(dir, ec);
+    const auto temp{dir / ("tmp-" + uniqueSuffix())};
+    auto depfile{temp};
+    depfile += ".d";
+    auto messages{temp};
+    messages += ".stderr";
+    std::vector<std::string> run{command.compiler};
+    run.insert(run.end(), command.flags.begin(), command.flags.end());
+    run.insert(run.end(), { "-MD", "-MF", depfile.string(), "-o", command.object, command.source });
+    const auto result{runCommand(commandLine(run) + " 2> " + shellQuoted(messages), cwd)};
+    std::cerr << std::ifstream{messages, std::ios::binary}.rdbuf() << std::flush;
+    auto inputs{dependencies(depfile)};
+    fs::remove(depfile, ec);
+    if (result.status != 0 || inputs.empty()) {
+        fs::remove(messages, ec);
+        return result.status < 0 ? 1 : result.status;
+    }
+    // the source comes first, and the files of -include may be missing after it
+    inputs.front() = command.source;
+    for (const auto& include : command.includes) {
+        if (std::find(inputs.begin(), inputs.end(), include) == inputs.end()) {
+            inputs.push_back(include);
+        }
+    }
+    writeDependencies(command, inputs);
+
+    Entry entry;
+    bool cacheable{!source.time};
+    bool fileMacro{source.file};
+    const auto sourcedir{(cwd / command.source).parent_path().lexically_normal()};
+    for (auto input{inputs.begin() + 1}; cacheable && input != inputs.end(); ++input) {
+        Contents contents;
+        Header header;
+        const auto path{(cwd / *input).lexically_normal()};
+        header.size = fs::file_size(path, ec);
+        header.time = modified(path, ec);
+        cacheable = !ec && examine(path, contents) && !contents.time;
+        fileMacro = fileMacro || contents.file;
+        header.digest = contents.digest;
+        const auto relative{path.lexically_relative(sourcedir)};
+        header.local = !relative.empty() && *relative.begin() != "..";
+        header.path = header.local ? relative : path;
+        entry.headers.push_back(header);
+    }
+    if (!cacheable) {
+        fs::remove(messages, ec);
+        return 0;
+    }
+    if (fileMacro) {
+        entry.source = command.source;
+    }
+    if (command.debug) {
+        entry.directory = cwd.string();
+    }
+    hash = fnv1a(entry.directory, fnv1a("\n", fnv1a(entry.source, fnv1a("\n", hash))));
+    for (const auto& header : entry.headers) {
+        hash = fnv1a(header.digest, fnv1a(header.local ? "\nlocal " : "\n", fnv1a(header.path.generic_string(), hash)));
+    }
+    entry.object = hexDigest(hash);
+    auto object{temp};
+    object += ".o";
+    fs::copy_file(command.object, object, fs::copy_options::overwrite_existing, ec);
+    if (!ec) {
+        fs::rename(object, dir / (entry.object + ".o"), ec);
+    }
+    if (!ec) {
+        fs::rename(messages, dir / (entry.object + ".stderr"), ec);
+    }
+    if (ec) {
+        fs::remove(object, ec);
+        fs::remove(messages, ec);
+        return 0;
+    }
+    const ManifestLock lock{dir};
+    auto entries{readManifest(manifest)};
+    entries.erase(std::remove_if(entries.begin(), entries.end(), [&](const Entry& old){ return old.object == entry.object; }), entries.end());
+    entries.insert(entries.begin(), entry);
+    // an object belongs to the one manifest whose digest is part of its own, so the least recently used go with their entries
+    for (auto old{entries.begin() + std::min(entries.size(), manifestLimit)}; old != entries.end(); ++old) {
+        fs::remove(dir / (old->object + ".o"), ec);
+        fs::remove(dir / (old->object + ".stderr"), ec);
+    }
+    entries.resize(std::min(entries.size(), manifestLimit));
+    writeManifest(manifest, entries);
+    return 0;
+}
+
+ObjectCache::Stats ObjectCache::stats() const {
+    Stats stats;
+    std::ifstream in{dir / statsName};
+    if (!(in >> stats.hits >> stats.misses)) {
+        return {};
+    }
+    return stats;
+}
+
+void ObjectCache::resetStats() const {
+    std::error_code ec;
+    fs::remove(dir / statsName, ec);
+}
+
+// helper functions
+
+/*! Take apart the compile command `args` into `command`.
+ *
+ * @return false if it is not a command that can be cached
+ */
+bool parse(const std::vector<std::string>& args, Command& command) {
+    // options whose value is the next argument
+    static const std::set<std::string_view> valued{
+        "-I", "-D", "-U", "-include", "-imacros", "-isystem", "-iquote", "-idirafter", "-iprefix", "-iwithprefix",
+        "-isysroot", "--sysroot", "-x", "-Xpreprocessor", "-Xassembler", "-Xclang", "-target", "-arch",
+    };
+    // output other than a single object, or input the command line does not show
+    static const std::set<std::string_view> uncacheable{"-E", "-S", "-M", "-MM", "-", "-gsplit-dwarf", "-save-temps"};
+    if (args.empty()) {
+        return false;
+    }
+    command.compiler = args.front();
+    bool compileOnly{false};
+    bool wantDeps{false};
+    for (std::size_t i{1}; i < args.size(); ++i) {
+        const auto& arg{args[i]};
+        const bool more{i + 1 < args.size()};
+        if (uncacheable.count(arg) || arg.rfind('@', 0) == 0) {
+            return false;
+        }
+        if (arg == "-o" && more) {
+            command.object = args[++i];
+        } else if (arg.rfind("-o", 0) == 0 && arg.size() > 2) {
+            command.object = arg.substr(2);
+        } else if (arg == "-MD" || arg == "-MMD") {
+            wantDeps = true;
+        } else if (arg == "-MP") {
+            command.phony = true;
+        } else if (arg == "-MF" && more) {
+            command.depfile = args[++i];
+        } else if ((arg == "-MT" || arg == "-MQ") && more) {
+            command.targets.push_back(args[++i]);
+        } else if (valued.count(arg) && more) {
+            if (arg == "-include") {
+                command.includes.push_back(args[i + 1]);
+            }
+            command.flags.push_back(arg);
+            command.flags.push_back(args[++i]);
+        } else if (arg.empty() || arg.front() != '-') {
+            if (!command.source.empty()) {
+                return false;
+            }
+            command.source = arg;
+        } else {
+            compileOnly = compileOnly || arg == "-c";
+            command.debug = command.debug || (arg.rfind("-g", 0) == 0 && arg != "-g0");
+            command.flags.push_back(arg);
+        }
+    }
+    if (wantDeps && command.depfile.empty()) {
+        command.depfile = fs::path{command.object}.replace_extension(".d").string();
+    }
+    if (!wantDeps) {
+        command.depfile.clear();
+    }
+    return compileOnly && !command.source.empty() && !command.object.empty();
+}
+
+/// read `filename` into `contents`; false if it cannot be read
+bool examine(const fs::path& filename, Contents& contents) {
+    try {
+        const MappedFile file{filename};
+        const auto text{file.view()};
+        contents.digest = hexDigest(fnv1a(text));
+        contents.file = text.find("__FILE__") != std::string_view::npos;
+        contents.time = text.find("__DATE__") != std::string_view::npos || text.find("__TIME__") != std::string_view::npos
+            || text.find("__TIMESTAMP__") != std::string_view::npos;
+        return true;
+    }
+    catch (std::exception&) {
+        return false;
+    }
+}
+
+/// the modification time of `filename`, as a count of file_time_type ticks
+long long modified(const fs::path& filename, std::error_code& ec) {
+    return static_cast<long long>(fs::last_write_time(filename, ec).time_since_epoch().count());
+}
+
+/*! true if every header of `entry` is as it was, and then `named` gains
+ * each header as this compile names it.
+ *
+ * A header beside the source is always read, since another project's
+ * copy can have the same size and time; others are only read if their
+ * size or time has changed.
+ */
+bool matches(const Entry& entry, const Command& command, const fs::path& cwd, std::vector<std::string>& named) {
+    if ((!entry.source.empty() && entry.source != command.source) || (!entry.directory.empty() && entry.directory != cwd.string())) {
+        return false;
+    }
+    const auto sourcedir{(cwd / command.source).parent_path()};
+    for (const auto& header : entry.headers) {
+        const auto path{header.local ? sourcedir / header.path : header.path};
+        std::error_code ec;
+        const auto size{fs::file_size(path, ec)};
+        const auto time{modified(path, ec)};
+        if (ec || size != header.size) {
+            return false;
+        }
+        if (header.local || time != header.time) {
+            Contents contents;
+            if (!examine(path, contents) || contents.digest != header.digest) {
+                return false;
+            }
+        }
+        named.push_back(header.local ? (fs::path{command.source}.parent_path() / header.path).string() : header.path.string());
+    }
+    return true;
+}
+
+/*! The manifest is a line of `manifestTag` followed by each entry: a
+ * line `object <name>`, optional lines `source <argument>` and
+ * `directory <path>`, a line `header <digest> <size> <time> <local|absolute> <path>`
+ * for each header and a line `end`.
+ */
+std::vector<Entry> readManifest(const fs::path& filename) {
+    std::vector<Entry> entries;
+    std::ifstream in{filename, std::ios::binary};
+    std::string line;
+    if (!std::getline(in, line) || line != manifestTag) {
+        return entries;
+    }
+    Entry entry;
+    while (std::getline(in, line)) {
+        std::istringstream words{line};
+        std::string kind;
+        words >> kind;
+        auto rest = [&]{
+            std::string text;
+            std::getline(words >> std::ws, text);
+            return text;
+        };
+        if (kind == "object") {
+            entry = {};
+            entry.object = rest();
+        } else if (kind == "source") {
+            entry.source = rest();
+        } else if (kind == "directory") {
+            entry.directory = rest();
+        } else if (kind == "header") {
+            Header header;
+            std::string where;
+            if (!(words >> header.digest >> header.size >> header.time >> where)) {
+                return {};
+            }
+            header.local = where == "local";
+            header.path = rest();
+            entry.headers.push_back(header);
+        } else if (kind == "end") {
+            entries.push_back(entry);
+        }
+    }
+    return entries;
+}
+
+void writeManifest(const fs::path& filename, const std::vector<Entry>& entries) {
+    replaceFile(filename, [&](const fs::path& tmpfile) {
+        std::ofstream out{tmpfile, std::ios::binary};
+        out << manifestTag << '\n';
+        for (const auto& entry : entries) {
+            out << "object " << entry.object << '\n';
+            if (!entry.source.empty()) {
+                out << "source " << entry.source << '\n';
+            }
+            if (!entry.directory.empty()) {
+                out << "directory " << entry.directory << '\n';
+            }
+            for (const auto& header : entry.headers) {
+                out << "header " << header.digest << ' ' << header.size << ' ' << header.time << ' '
+                    << (header.local ? "local " : "absolute ") << header.path.string() << '\n';
+            }
+            out << "end\n";
+        }
+        out.close();
+        return static_cast<bool>(out);
+    });
+}
+
+/// move the entry of `object` to the front of the manifest `filename`, as the one most recently used
+void promote(const fs::path& filename, const std::string& object) {
+    const ManifestLock lock{filename.parent_path()};
+    auto entries{readManifest(filename)};
+    const auto found{std::find_if(entries.begin(), entries.end(), [&](const Entry& entry){ return entry.object == object; })};
+    if (found == entries.end() || found == entries.begin()) {
+        return;
+    }
+    std::rotate(entries.begin(), found, found + 1);
+    writeManifest(filename, entries);
+}
+
+/// the prerequisites of the single rule in the make style `depfile`
+std::vector<std::string> dependencies(const fs::path& depfile) {
+    std::ifstream in{depfile, std::ios::binary};
+    const std::string text{std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{}};
+    std::vector<std::string> names;
+    std::string name;
+    bool target{true};
+    auto blank = [](char ch){ return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r'; };
+    for (std::size_t i{0}; i < text.size(); ++i) {
+        const char ch{text[i]};
+        const char next{i + 1 < text.size() ? text[i + 1] : '\n'};
+        if (ch == '\\' && (next == ' ' || next == '#' || next == '\\')) {
+            name += next;
+            ++i;
+        } else if (ch == '$' && next == '$') {
+            name += '$';
+            ++i;
+        } else if (ch == '\\' && (next == '\n' || next == '\r')) {
+            ++i;
+        } else if (target && ch == ':' && blank(next)) {
+            target = false;
+            name.clear();
+        } else if (blank(ch)) {
+            if (!target && !name.empty()) {
+                names.push_back(name);
+            }
+            name.clear();
+        } else {
+            name += ch;
+        }
+    }
+    if (!target && !name.empty()) {
+        names.push_back(name);
+    }
+    return names;
+}
+
+/// write the dependency file that `command` asks for, if any, with the source and headers `inputs`
+void writeDependencies(const Command& command, const std::vector<std::string>& inputs) {
+    if (command.depfile.empty()) {
+        return;
+    }
+    std::ofstream out{command.depfile, std::ios::binary};
+    const auto& targets{command.targets.empty() ? std::vector<std::string>{command.object} : command.targets};
+    for (const auto& target : targets) {
+        out << (&target == &targets.front() ? "" : " ") << escaped(target);
+    }
+    out << ':';
+    for (const auto& input : inputs) {
+        out << " \\\n " << escaped(input);
+    }
+    out << '\n';
+    if (command.phony) {
+        for (auto input{inputs.begin() + 1}; input < inputs.end(); ++input) {
+            out << '\n' << escaped(*input) << ":\n";
+        }
+    }
+}
+
+/// `name` as it must be written in a dependency file
+std::string escaped(const std::string& name) {
+    std::string text;
+    for (const char ch : name) {
+        if (ch == ' ' || ch == '#') {
+            text += '\\';
+        } else if (ch == '$') {
+            text += '$';
+        }
+        text += ch;
+    }
+    return text;
+}
+
+/// `args` as a command line for the shell, each one quoted
+std::string commandLine(const std::vector<std::string>& args) {
+    std::string line;
+    for (const auto& arg : args) {
+        line += (line.empty() ? "" : " ") + shellQuoted(arg);
+    }
+    return line;
+}
+
+/*! add one to the hits or the misses counted in `dir`.
+ *
+ * Both counts are in one small file, which each compile reads and
+ * rewrites while it holds a lock on it, so that concurrent compiles all
+ * count.  On Windows there is no lock, so a race may lose a count.
+ */
+void count(const fs::path& dir, bool hit) {
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    const auto filename{dir / statsName};
+    ObjectCache::Stats stats;
+    auto next = [&](std::string_view text) {
+        std::istringstream in{std::string{text}};
+        if (!(in >> stats.hits >> stats.misses)) {
+            stats = {};
+        }
+        ++(hit ? stats.hits : stats.misses);
+        return std::to_string(stats.hits) + ' ' + std::to_string(stats.misses) + '\n';
+    };
+#ifndef _WIN32
+    const int fd{::open(filename.c_str(), O_RDWR | O_CREAT, 0666)};
+    if (fd < 0) {
+        return;
+    }
+    if (flock(fd, LOCK_EX) == 0) {
+        char text[64];
+        const auto got{pread(fd, text, sizeof text, 0)};
+        const auto line{next({text, got > 0 ? static_cast<std::size_t>(got) : 0})};
+        if (pwrite(fd, line.data(), line.size(), 0) == static_cast<ssize_t>(line.size())) {
+            static_cast<void>(ftruncate(fd, static_cast<off_t>(line.size())));
+        }
+    }
+    ::close(fd);
+#else
+    std::ifstream in{filename, std::ios::binary};
+    const std::string text{std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{}};
+    in.close();
+    std::ofstream{filename, std::ios::binary} << next(text);
+#endif
+}
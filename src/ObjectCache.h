@@ -0,0 +1,72 @@
+#ifndef OBJECTCACHE_H
+#define OBJECTCACHE_H
+#include "config.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#if HAS_FILESYSTEM
+#include <filesystem>
+namespace fs = std::filesystem;
+#else
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#endif
+
+/*! A cache of compiled objects shared by every project, keyed on what
+ * went into them.
+ *
+ * Posts are often posted again, edited or share helper files word for
+ * word, so the same translation unit is compiled in many project
+ * directories.  The build files run each compile through the cache
+ * instead, as `autoproject --object-cache <cachedir> <compiler> <args>`,
+ * and the cache in `<cachedir>/objects` gives back the object of an
+ * earlier compile whenever the compiler, its flags and the contents of
+ * the source and of every header it included are all the same.
+ *
+ * As ccache does in its direct mode, the headers are not found by
+ * running the preprocessor.  For each compiler, flags and source there
+ * is a manifest of the headers each earlier compile included, with
+ * their digests, and a compile matches one of those entries if each of
+ * its headers still has the same contents.  Headers beside the source
+ * are recorded relative to it, so that the same files in another
+ * project's directory match too.  An object is only shared between
+ * sources given by the same path if any input mentions `__FILE__`, and
+ * between the same working directories if it has debug information.
+ * Inputs that mention the date or time are never cached.  Each manifest
+ * keeps only its most recently used entries, a hit moving its own to the
+ * front, and the objects of the rest are deleted with them.  Manifests
+ * are only changed under a lock, so concurrent compiles keep every entry.
+ *
+ * Only GCC style compile commands with `-c` and `-o` and a single source
+ * are cached; anything else, such as a link, is simply run.  Any
+ * dependency file the command asks for is written by the cache.
+ */
+class ObjectCache {
+public:
+    /// how often compiles found their object in the cache
+    struct Stats {
+        std::size_t hits = 0;
+        std::size_t misses = 0;
+    };
+
+    /// the cache in `cachedir`, which also holds the cache of the compiler's identity
+    explicit ObjectCache(const fs::path& cachedir);
+    /*! run the compile command `args`, the compiler and its arguments,
+     * in the current directory, unless its object is already in the
+     * cache.
+     *
+     * @return the exit status of the compiler, or 0 for a hit
+     */
+    int compile(const std::vector<std::string>& args) const;
+    /// the hits and misses since the last reset
+    Stats stats() const;
+    /// start counting hits and misses afresh
+    void resetStats() const;
+
+    /// the directory of the objects and their manifests
+    fs::path dir;
+private:
+    fs::path cachedir;
+};
+#endif // OBJECTCACHE_H
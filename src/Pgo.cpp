@@ -0,0 +1,46 @@
+#include "config.h"
+#include "Pgo.h"
+#include "CMakeBuild.h"
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+int runPgo(const AutoProject& ap, const std::string& training, std::ostream& out) {
+    try {
+        const CMakeBuild project{ap, training};
+        const auto plain{project.projectDir() / ap.buildDir()};
+        auto instrumented{plain};
+        instrumented += "-pgo";
+        // profiles of an earlier training run would be merged with the new one
+        fs::remove_all(instrumented / "pgo");
+
+        project.configure(instrumented, {"AUTOPROJECT_PGO=generate"});
+        project.build(instrumented);
+        out << "Training " << project.program(instrumented).filename().string() << " with: " << project.arguments() << '\n';
+        const auto trained{project.run(instrumented)};
+        if (trained.timedOut) {
+            throw std::runtime_error("the training run did not finish in time");
+        }
+        if (trained.status != 0) {
+            out << "Warning: the training run exited with status " << trained.status << '\n';
+        }
+        project.configure(instrumented, {"AUTOPROJECT_PGO=use"});
+        project.build(instrumented);
+        project.configure(plain, {"AUTOPROJECT_PGO="});
+        project.build(plain);
+
+        const auto before{project.bestTime(plain)};
+        const auto after{project.bestTime(instrumented)};
+        const auto gain{before.count() > 0 ? 100.0 * (before.count() - after.count()) / before.count() : 0.0};
+        out << std::fixed << std::setprecision(3)
+            << std::left << std::setw(32) << plain.filename().string() << before.count() << " s\n"
+            << std::setw(32) << instrumented.filename().string() << after.count() << " s ("
+            << std::setprecision(1) << std::abs(gain) << (gain < 0 ? "% slower)\n" : "% faster)\n");
+    }
+    catch(std::exception& e) {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,20 @@
+#ifndef PGO_H
+#define PGO_H
+#include "AutoProject.h"
+#include <ostream>
+#include <string>
+
+/*! Build the project `ap` has created with profile-guided optimization
+ * and compare it with the plain build of its profile.
+ *
+ * The project is built with CMake in a `<buildDir>-pgo` directory, first
+ * instrumented, then run once for training, then again using the
+ * profile that run wrote.  The training run is given the arguments
+ * `training`, as described for CMakeBuild.  The plain build goes in
+ * `<buildDir>` as ever, and the runtime of each binary, the best of
+ * several runs, is printed to `out`; errors are reported to `std::cerr`.
+ *
+ * @return the process exit status
+ */
+int runPgo(const AutoProject& ap, const std::string& training, std::ostream& out);
+#endif // PGO_H
@@ -0,0 +1,160 @@
+#include "Process.h"
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <csignal>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Process interface functions
+
+#ifdef _WIN32
+CommandResult runCommand(const std::string& command, const fs::path& dir, std::chrono::milliseconds) {
+    CommandResult result;
+    const auto start{std::chrono::steady_clock::now()};
+    // cmd.exe strips the outer quotes of the whole line, so they are added here
+    result.status = std::system(("\"cd /d " + shellQuoted(dir) + " && " + command + '"').c_str());
+    result.elapsed = std::chrono::steady_clock::now() - start;
+    return result;
+}
+
+void startCommand(const std::string& command, const fs::path& dir) {
+    std::thread{[command, dir]{ runCommand(command, dir); }}.detach();
+}
+#else
+/*! The command runs in a process group of its own, so that stopping it
+ * also stops whatever it started, such as the program a shell
+ * redirection runs.  While there is a limit, the parent polls for the
+ * child every millisecond, which is also as precise as `elapsed` is.
+ */
+CommandResult runCommand(const std::string& command, const fs::path& dir, std::chrono::milliseconds limit) {
+    CommandResult result;
+    const auto start{std::chrono::steady_clock::now()};
+    const pid_t child{fork()};
+    if (child < 0) {
+        return result;
+    }
+    if (child == 0) {
+        setpgid(0, 0);
+        if (chdir(dir.c_str()) == 0) {
+            execl("/bin/sh", "sh", "-c", command.c_str(), static_cast<char *>(nullptr));
+        }
+        _exit(127);
+    }
+    setpgid(child, child);
+    int status{0};
+    pid_t done{0};
+    if (limit.count() == 0) {
+        done = waitpid(child, &status, 0);
+    } else {
+        while ((done = waitpid(child, &status, WNOHANG)) == 0) {
+            if (std::chrono::steady_clock::now() - start > limit) {
+                kill(-child, SIGKILL);
+                done = waitpid(child, &status, 0);
+                result.timedOut = true;
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+        }
+    }
+    result.elapsed = std::chrono::steady_clock::now() - start;
+    if (done == child && !result.timedOut && WIFEXITED(status)) {
+        result.status = WEXITSTATUS(status);
+    }
+    return result;
+}
+
+/*! The command runs in a grandchild in a session of its own, so that
+ * it is not stopped with this program, and the child in between exits
+ * at once, so that it is reaped here and the grandchild never becomes a
+ * zombie of this process.
+ */
+void startCommand(const std::string& command, const fs::path& dir) {
+    const pid_t child{fork()};
+    if (child < 0) {
+        return;
+    }
+    if (child == 0) {
+        setsid();
+        if (fork() == 0) {
+            const int null{open("/dev/null", O_RDWR)};
+            dup2(null, 0);
+            dup2(null, 1);
+            dup2(null, 2);
+            if (chdir(dir.c_str()) == 0) {
+                execl("/bin/sh", "sh", "-c", command.c_str(), static_cast<char *>(nullptr));
+            }
+        }
+        _exit(0);
+    }
+    waitpid(child, nullptr, 0);
+}
+#endif
+
+/*! On Windows a backslash only escapes a quote or the backslashes
+ * before one, as the C runtime splits a command line; elsewhere the
+ * characters that stay special inside double quotes are escaped.
+ */
+std::string shellQuoted(const fs::path& path) {
+    std::string quoted{'"'};
+#ifdef _WIN32
+    std::size_t backslashes{0};
+    for (const char ch : path.string()) {
+        if (ch == '\\') {
+            ++backslashes;
+            continue;
+        }
+        quoted.append(ch == '"' ? 2 * backslashes + 1 : backslashes, '\\');
+        quoted += ch;
+        backslashes = 0;
+    }
+    quoted.append(2 * backslashes, '\\');
+#else
+    for (const char ch : path.string()) {
+        if (ch == '"' || ch == '\\' || ch == '$' || ch == '`') {
+            quoted += '\\';
+        }
+        quoted += ch;
+    }
+#endif
+    return quoted + '"';
+}
+
+/*! The process id tells processes apart and a counter the threads and
+ * calls of this one; the time guards against a process id that has
+ * been used again since a name was left behind.
+ */
+std::string uniqueSuffix() {
+    static std::atomic<unsigned long> calls{0};
+#ifdef _WIN32
+    const auto pid{_getpid()};
+#else
+    const auto pid{getpid()};
+#endif
+    return std::to_string(pid) + '-' + std::to_string(calls++)
+        + '-' + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+}
+
+bool replaceFile(const fs::path& filename, const std::function<bool(const fs::path&)>& write) {
+    std::error_code ec;
+    if (filename.has_parent_path()) {
+        fs::create_directories(filename.parent_path(), ec);
+    }
+    auto tmpfile{filename};
+    tmpfile += ".tmp" + uniqueSuffix();
+    if (write(tmpfile)) {
+        fs::rename(tmpfile, filename, ec);
+        if (!ec) {
+            return true;
+        }
+    }
+    fs::remove(tmpfile, ec);
+    return false;
+}
@@ -0,0 +1,60 @@
+#ifndef PROCESS_H
+#define PROCESS_H
+#include "config.h"
+#include <chrono>
+#include <functional>
+#include <string>
+
+#if HAS_FILESYSTEM
+#include <filesystem>
+namespace fs = std::filesystem;
+#else
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#endif
+
+/// how a command run by runCommand() went
+struct CommandResult {
+    // the exit status, or -1 if the command could not be run or did not exit normally
+    int status = -1;
+    // wall clock time from starting the command to its end
+    std::chrono::duration<double> elapsed{};
+    // it was stopped for taking longer than the time limit
+    bool timedOut = false;
+};
+
+/*! run `command` with the shell, in directory `dir`.
+ *
+ * The command inherits the standard streams, so any redirection is up
+ * to the command itself.  If `limit` is not zero and the command takes
+ * longer, it is stopped along with everything it started; on Windows
+ * there is no limit.
+ */
+CommandResult runCommand(const std::string& command, const fs::path& dir, std::chrono::milliseconds limit = {});
+
+/*! start `command` with the shell, in directory `dir`, and return at
+ * once without waiting for it.
+ *
+ * The command is detached from this process and from its standard
+ * streams, so it goes on running after this program exits; on Windows
+ * it runs on a thread of this program instead.
+ */
+void startCommand(const std::string& command, const fs::path& dir);
+
+/// `path`, or any other argument, quoted for the shell as one word
+std::string shellQuoted(const fs::path& path);
+
+/// a suffix for a name that no other thread or process is using
+std::string uniqueSuffix();
+
+/*! replace `filename` with the file that `write` makes at the private
+ * path it is given, so that other threads and processes see either the
+ * old file or the whole new one, never a partial one.
+ *
+ * If `write` returns false, or the file cannot be moved into place, it
+ * is removed and `filename` is left as it was.
+ *
+ * @return true if `filename` was replaced
+ */
+bool replaceFile(const fs::path& filename, const std::function<bool(const fs::path&)>& write);
+#endif // PROCESS_H
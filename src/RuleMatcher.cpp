@@ -0,0 +1,343 @@
+#include "RuleMatcher.h"
+#include <algorithm>
+#include <cctype>
+#include <deque>
+#include <optional>
+
+// helper functions
+static std::size_t skipGroup(std::string_view re, std::size_t pos);
+static std::size_t skipClass(std::string_view re, std::size_t pos);
+static std::optional<std::vector<std::string>> literalAlternatives(std::string_view re);
+static std::vector<std::vector<std::string>> requiredFactors(std::string_view re);
+static std::string commonLiteral(const std::vector<std::vector<std::vector<std::string>>>& factors);
+
+// RuleMatcher interface functions
+std::size_t RuleMatcher::add(const std::string& pattern, Compile when) {
+    auto compiled{std::make_unique<Pattern>()};
+    compiled->text = pattern;
+    if (when == Compile::now) {
+        std::call_once(compiled->compiled, [&]{ compiled->re.assign(pattern); });
+    }
+    regexes.push_back(std::move(compiled));
+    factors.push_back(requiredFactors(pattern));
+    return regexes.size() - 1;
+}
+
+void RuleMatcher::compile() {
+    common = commonLiteral(factors);
+    nodes.assign(1, Node{});
+    always.clear();
+    for (std::size_t rule{0}; rule < factors.size(); ++rule) {
+        // the longest literal makes the most selective key, but one that
+        // the prefilter has already established tells us nothing new
+        const Factor *best{nullptr};
+        std::size_t bestScore{0};
+        for (const auto& factor : factors[rule]) {
+            std::size_t score{factor.front().size()};
+            for (const auto& alternative : factor) {
+                score = std::min(score, alternative.size());
+            }
+            if (factor.size() == 1 && common.find(factor.front()) != std::string::npos) {
+                score = 0;
+            }
+            if (!best || score > bestScore) {
+                best = &factor;
+                bestScore = score;
+            }
+        }
+        if (best) {
+            for (const auto& alternative : *best) {
+                insert(alternative, rule);
+            }
+        } else {
+            always.push_back(rule);
+        }
+    }
+    // breadth first, so that each node's failure target is already complete
+    std::deque<std::uint32_t> queue;
+    for (const auto& edge : nodes[0].next) {
+        queue.push_back(edge.second);
+    }
+    while (!queue.empty()) {
+        const auto node{queue.front()};
+        queue.pop_front();
+        for (const auto& [ch, target] : nodes[node].next) {
+            const auto fail{node == 0 ? 0 : step(nodes[node].fail, ch)};
+            nodes[target].fail = fail == target ? 0 : fail;
+            const auto& inherited{nodes[nodes[target].fail].rules};
+            nodes[target].rules.insert(nodes[target].rules.end(), inherited.begin(), inherited.end());
+            queue.push_back(target);
+        }
+    }
+    factors.clear();
+}
+
+std::vector<std::size_t> RuleMatcher::match(std::string_view line) const {
+    std::vector<std::size_t> found;
+    if (regexes.empty() || (!common.empty() && line.find(common) == std::string_view::npos)) {
+        return found;
+    }
+    std::vector<std::size_t> candidates{always};
+    std::uint32_t node{0};
+    for (const char ch : line) {
+        node = step(node, ch);
+        const auto& rules{nodes[node].rules};
+        candidates.insert(candidates.end(), rules.begin(), rules.end());
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+    for (const auto rule : candidates) {
+        if (std::regex_search(line.begin(), line.end(), regex(rule))) {
+            found.push_back(rule);
+        }
+    }
+    return found;
+}
+
+/// the regex of rule `id`, constructing it first if need be
+const std::regex& RuleMatcher::regex(std::size_t id) const {
+    auto& pattern{*regexes[id]};
+    std::call_once(pattern.compiled, [&]{ pattern.re.assign(pattern.text); });
+    return pattern.re;
+}
+
+/// the node reached from `node` on `ch` without following failure links, or 0
+std::uint32_t RuleMatcher::child(std::uint32_t node, char ch) const {
+    const auto& next{nodes[node].next};
+    auto it{std::lower_bound(next.begin(), next.end(), ch,
+            [](const auto& edge, char c){ return edge.first < c; })};
+    return it != next.end() && it->first == ch ? it->second : 0;
+}
+
+/// the automaton's transition function
+std::uint32_t RuleMatcher::step(std::uint32_t node, char ch) const {
+    for (;;) {
+        if (auto target{child(node, ch)}) {
+            return target;
+        }
+        if (node == 0) {
+            return 0;
+        }
+        node = nodes[node].fail;
+    }
+}
+
+void RuleMatcher::insert(const std::string& literal, std::size_t rule) {
+    std::uint32_t node{0};
+    for (const char ch : literal) {
+        auto target{child(node, ch)};
+        if (!target) {
+            target = static_cast<std::uint32_t>(nodes.size());
+            auto& next{nodes[node].next};
+            next.insert(std::lower_bound(next.begin(), next.end(), ch,
+                    [](const auto& edge, char c){ return edge.first < c; }),
+                    {ch, target});
+            nodes.emplace_back();
+        }
+        node = target;
+    }
+    nodes[node].rules.push_back(rule);
+}
+
+// helper functions
+
+/// returns the position just past the group whose '(' is at `pos`
+std::size_t skipGroup(std::string_view re, std::size_t pos) {
+    unsigned depth{0};
+    while (pos < re.size()) {
+        switch (re[pos]) {
+            case '\\':
+                pos += 2;
+                continue;
+            case '[':
+                pos = skipClass(re, pos);
+                continue;
+            case '(':
+                ++depth;
+                break;
+            case ')':
+                if (--depth == 0) {
+                    return pos + 1;
+                }
+                break;
+        }
+        ++pos;
+    }
+    return pos;
+}
+
+/// returns the position just past the character class whose '[' is at `pos`
+std::size_t skipClass(std::string_view re, std::size_t pos) {
+    for (++pos; pos < re.size() && re[pos] != ']'; ++pos) {
+        if (re[pos] == '\\') {
+            ++pos;
+        }
+    }
+    return pos + 1;
+}
+
+/*! if `re` is nothing but literal text separated by '|', returns the
+ * alternatives, otherwise nothing.
+ */
+std::optional<std::vector<std::string>> literalAlternatives(std::string_view re) {
+    static constexpr std::string_view special{".^$*+?()[]{}|\\"};
+    std::vector<std::string> alternatives(1);
+    for (std::size_t i{0}; i < re.size(); ++i) {
+        if (re[i] == '|') {
+            alternatives.emplace_back();
+        } else if (re[i] == '\\' && i + 1 < re.size() && !std::isalnum(static_cast<unsigned char>(re[i + 1]))) {
+            alternatives.back() += re[++i];
+        } else if (special.find(re[i]) == std::string_view::npos) {
+            alternatives.back() += re[i];
+        } else {
+            return std::nullopt;
+        }
+    }
+    for (const auto& alternative : alternatives) {
+        if (alternative.empty()) {
+            return std::nullopt;
+        }
+    }
+    return alternatives;
+}
+
+/*! Returns the factors of the ECMAScript regex `re`: sets of literal
+ * alternatives such that any match contains at least one alternative of
+ * every factor.  The analysis is conservative; anything it does not
+ * understand simply contributes no factor.
+ */
+std::vector<std::vector<std::string>> requiredFactors(std::string_view re) {
+    std::vector<std::vector<std::string>> factors;
+    std::string run;
+    auto endRun = [&]{
+        if (!run.empty()) {
+            factors.push_back({run});
+            run.clear();
+        }
+    };
+    for (std::size_t i{0}; i < re.size(); ) {
+        enum class Atom { literal, other, group, assertion } atom{Atom::other};
+        char value{};
+        std::vector<std::vector<std::string>> inner;
+        const char ch{re[i]};
+        if (ch == '\\') {
+            const char esc{i + 1 < re.size() ? re[i + 1] : '\\'};
+            i += 2;
+            if (!std::isalnum(static_cast<unsigned char>(esc))) {
+                atom = Atom::literal;
+                value = esc;
+            } else if (esc == 'n' || esc == 't' || esc == 'r' || esc == 'f' || esc == 'v') {
+                atom = Atom::literal;
+                value = std::string_view{"\n\t\r\f\v"}[std::string_view{"ntrfv"}.find(esc)];
+            } else if (esc == 'b' || esc == 'B') {
+                atom = Atom::assertion;
+            } else if (esc == 'x') {
+                i += 2;
+            } else if (esc == 'u') {
+                i += 4;
+            } else if (esc == 'c') {
+                i += 1;
+            } else {
+                while (i < re.size() && std::isdigit(static_cast<unsigned char>(re[i]))) {
+                    ++i;
+                }
+            }
+        } else if (ch == '[') {
+            i = skipClass(re, i);
+        } else if (ch == '(') {
+            const auto end{skipGroup(re, i)};
+            auto body{re.substr(i + 1, end - i - 2)};
+            i = end;
+            if (body.substr(0, 2) == "?:") {
+                body.remove_prefix(2);
+            } else if (!body.empty() && body[0] == '?') {
+                // lookahead
+                endRun();
+                continue;
+            }
+            atom = Atom::group;
+            if (auto alternatives{literalAlternatives(body)}) {
+                inner.push_back(std::move(*alternatives));
+            } else {
+                inner = requiredFactors(body);
+            }
+        } else if (ch == '^' || ch == '$') {
+            ++i;
+            atom = Atom::assertion;
+        } else if (ch == '|' || ch == ')') {
+            // an alternative at the top level requires nothing
+            return {};
+        } else if (ch == '.' || ch == '*' || ch == '+' || ch == '?' || ch == '{') {
+            ++i;
+        } else {
+            ++i;
+            atom = Atom::literal;
+            value = ch;
+        }
+        // quantifier
+        bool optional{false};
+        bool repeated{false};
+        if (i < re.size() && atom != Atom::assertion) {
+            if (re[i] == '*' || re[i] == '?') {
+                optional = true;
+                ++i;
+            } else if (re[i] == '+') {
+                repeated = true;
+                ++i;
+            } else if (re[i] == '{') {
+                optional = i + 1 < re.size() && re[i + 1] == '0';
+                repeated = !optional;
+                i = std::min(re.find('}', i), re.size() - 1) + 1;
+            }
+            if ((optional || repeated) && i < re.size() && re[i] == '?') {
+                ++i;
+            }
+        }
+        if (atom == Atom::literal && !optional) {
+            run += value;
+            if (repeated) {
+                endRun();
+            }
+        } else {
+            endRun();
+            if (atom == Atom::group && !optional) {
+                factors.insert(factors.end(), inner.begin(), inner.end());
+            }
+        }
+    }
+    endRun();
+    return factors;
+}
+
+/// returns the longest literal required by every rule, or the empty string
+std::string commonLiteral(const std::vector<std::vector<std::vector<std::string>>>& factors) {
+    if (factors.empty()) {
+        return {};
+    }
+    auto requiredBy = [](const std::vector<std::vector<std::string>>& rule, std::string_view literal) {
+        for (const auto& factor : rule) {
+            if (factor.size() == 1 && factor.front().find(literal) != std::string::npos) {
+                return true;
+            }
+        }
+        return false;
+    };
+    std::string best;
+    for (const auto& factor : factors.front()) {
+        if (factor.size() != 1) {
+            continue;
+        }
+        const std::string_view literal{factor.front()};
+        for (std::size_t start{0}; start < literal.size(); ++start) {
+            for (std::size_t len{literal.size() - start}; len > best.size(); --len) {
+                const auto candidate{literal.substr(start, len)};
+                if (std::all_of(factors.begin() + 1, factors.end(),
+                        [&](const auto& rule){ return requiredBy(rule, candidate); })) {
+                    best = candidate;
+                    break;
+                }
+            }
+        }
+    }
+    return best;
+}
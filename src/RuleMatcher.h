@@ -0,0 +1,78 @@
+#ifndef RULEMATCHER_H
+#define RULEMATCHER_H
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/*! Matches a line against a whole set of rule regexes at once.
+ *
+ * Each rule regex is examined for literal text that any match must
+ * contain.  All of those literals are compiled into a single
+ * Aho-Corasick automaton, so one pass over a line yields the few rules
+ * that could possibly match, and only those are handed to the regex
+ * engine.  If one literal is common to every rule (typically
+ * "#include"), lines without it are rejected before the automaton runs.
+ *
+ * Rules are added with add() and the matcher is made ready with
+ * compile(); after that it is immutable and match() may be called from
+ * any number of threads.  A rule added with Compile::lazily has its regex
+ * constructed only when some line first gets as far as needing it.
+ */
+class RuleMatcher {
+public:
+    enum class Compile { now, lazily };
+    /*! add a rule and return its id.
+     *
+     * With Compile::now, throws std::regex_error if `pattern` is invalid;
+     * Compile::lazily is for patterns already known to be valid.
+     */
+    std::size_t add(const std::string& pattern, Compile when = Compile::now);
+    /// build the automaton; must be called after the last add()
+    void compile();
+    /// ids, in ascending order, of the rules whose regex is found in `line`
+    std::vector<std::size_t> match(std::string_view line) const;
+    /// number of rules
+    std::size_t size() const { return regexes.size(); }
+    /// the regex of rule `id` as it was added
+    const std::string& pattern(std::size_t id) const { return regexes[id]->text; }
+    /// literal that every rule requires, or empty if there is none
+    const std::string& prefilter() const { return common; }
+
+private:
+    /// literal alternatives, at least one of which occurs in any match
+    using Factor = std::vector<std::string>;
+
+    struct Node {
+        // transitions, sorted by character
+        std::vector<std::pair<char, std::uint32_t>> next;
+        std::uint32_t fail = 0;
+        // rules with a literal ending here
+        std::vector<std::size_t> rules;
+    };
+
+    struct Pattern {
+        std::string text;
+        std::once_flag compiled;
+        std::regex re;
+    };
+
+    const std::regex& regex(std::size_t id) const;
+    std::uint32_t child(std::uint32_t node, char ch) const;
+    std::uint32_t step(std::uint32_t node, char ch) const;
+    void insert(const std::string& literal, std::size_t rule);
+
+    std::vector<std::unique_ptr<Pattern>> regexes;
+    // required literals per rule; only needed until compile()
+    std::vector<std::vector<Factor>> factors;
+    std::vector<Node> nodes;
+    // rules without any usable literal, which must always be tried
+    std::vector<std::size_t> always;
+    std::string common;
+};
+#endif // RULEMATCHER_H
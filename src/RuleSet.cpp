@@ -0,0 +1,228 @@
+#include "RuleSet.h"
+#include "Hash.h"
+#include "Process.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <regex>
+#include <sstream>
+#include <utility>
+
+// local constants
+static constexpr std::string_view cacheTag{"autoproject rules cache 2"};
+
+// helper functions
+static bool isHeaderRule(std::string_view field);
+static std::string expandNewlines(std::string text);
+
+// RuleSet interface functions
+RuleSet::RuleSet(const fs::path& rulesfile, const fs::path& cachedir, bool rebuildCache) {
+    const auto start{std::chrono::steady_clock::now()};
+    std::ifstream in(rulesfile, std::ios::binary);
+    if (!in) {
+        std::cerr << "Unable to open rules file: " << rulesfile << "\n";
+        return;
+    }
+    std::stringstream text;
+    text << in.rdbuf();
+    // the cache is only good for the same rules read by the same version
+    fs::path cachefile;
+    if (!cachedir.empty()) {
+        cachefile = cachedir / ("rules-" + hexDigest(fnv1a(text.str(), fnv1a(VERSION))) + ".cache");
+    }
+    const bool cached{!cachefile.empty() && !rebuildCache && readCache(cachefile)};
+    if (!cached) {
+        parse(text, rulesfile);
+        if (!cachefile.empty()) {
+            writeCache(cachefile);
+        }
+    }
+    matcher.compile();
+    const std::chrono::duration<double, std::milli> elapsed{std::chrono::steady_clock::now() - start};
+    std::cout << "Loaded " << rules.size() << " rules" << (cached ? " from cache" : "")
+        << " in " << elapsed.count() << " ms\n";
+}
+
+/*! A rule set is loaded again whenever the size or modification time of
+ * its file has changed, as a long running daemon would otherwise go on
+ * using rules that have since been edited; also when asked for with
+ * another cache directory, or with `rebuildCache` if it was not itself
+ * loaded that way.
+ */
+std::shared_ptr<const RuleSet> RuleSet::shared(const fs::path& rulesfile, const fs::path& cachedir, bool rebuildCache) {
+    struct Loaded {
+        std::uintmax_t size = 0;
+        fs::file_time_type time{};
+        fs::path cachedir;
+        bool rebuilt = false;
+        std::shared_ptr<const RuleSet> rules;
+    };
+    static std::mutex mtx;
+    static std::map<fs::path, Loaded> loaded;
+    std::error_code ec;
+    const auto size{fs::file_size(rulesfile, ec)};
+    const auto time{ec ? fs::file_time_type{} : fs::last_write_time(rulesfile, ec)};
+    std::lock_guard<std::mutex> lock{mtx};
+    auto& entry{loaded[rulesfile]};
+    if (!entry.rules || entry.size != size || entry.time != time || entry.cachedir != cachedir || (rebuildCache && !entry.rebuilt)) {
+        entry = {size, time, cachedir, rebuildCache, std::make_shared<const RuleSet>(rulesfile, cachedir, rebuildCache)};
+    }
+    return entry.rules;
+}
+
+std::vector<std::size_t> RuleSet::match(std::string_view line) const {
+    std::vector<std::size_t> found;
+    if (!headers.empty()) {
+        if (const auto header{includedHeader(line)}; !header.empty()) {
+            const auto [first, last]{headers.equal_range(std::string{header})};
+            for (auto it{first}; it != last; ++it) {
+                found.push_back(it->second);
+            }
+        }
+    }
+    for (const auto id : matcher.match(line)) {
+        found.push_back(patterns[id]);
+    }
+    std::sort(found.begin(), found.end());
+    return found;
+}
+
+/// add `rule` keyed by header name if `kind` is 'h' or else by the regex `key`
+void RuleSet::add(char kind, const std::string& key, Rule rule, RuleMatcher::Compile when) {
+    if (kind == 'h') {
+        headers.emplace(key, rules.size());
+    } else {
+        matcher.add(key, when);
+        patterns.push_back(rules.size());
+    }
+    rules.push_back(std::move(rule));
+}
+
+void RuleSet::parse(std::istream& in, const fs::path& rulesfile) {
+    std::string line;
+    unsigned linenum{0};
+    static const std::regex rulefields{"([^@]+)@([^@]*)@([^@]*)(?:@(.*))?"};
+    while (std::getline(in, line)) {
+        ++linenum;
+        std::smatch pieces;
+        if (std::regex_match(line, pieces, rulefields) && pieces.size() == 5) {
+            try {
+                const std::string field{pieces[1]};
+                Rule rule{expandNewlines(pieces[2]), pieces[3], pieces[4]};
+                if (isHeaderRule(field)) {
+                    add('h', field.substr(1, field.size() - 2), std::move(rule), RuleMatcher::Compile::now);
+                } else {
+                    add('r', field, std::move(rule), RuleMatcher::Compile::now);
+                }
+            }
+            catch (std::regex_error& e) {
+                static constexpr std::string_view labels[5]{"line", "regex", "cmake lines", "libraries", "flags"};
+                std::cerr << "Error: " << e.what() << " in line " << linenum << " of rules file " << rulesfile << "\n";
+                for (unsigned i{0}; i < pieces.size(); ++i ) {
+                    std::cout << labels[i] << " = \"" << pieces[i] << "\"\n";
+                }
+            }
+        }
+    }
+}
+
+/*! The rule cache holds the rules as parsed from the rules file, each as
+ * a kind ('h' for header or 'r' for regex) and four length-prefixed
+ * strings: the key, the cmake lines, the libraries and the flags.
+ */
+bool RuleSet::readCache(const fs::path& cachefile) {
+    std::ifstream in{cachefile, std::ios::binary};
+    std::string tag;
+    std::string version;
+    std::size_t count{0};
+    if (!std::getline(in, tag) || tag != cacheTag || !std::getline(in, version) || version != VERSION || !(in >> count)) {
+        return false;
+    }
+    auto field = [&in](std::string& str) {
+        std::size_t size;
+        if (in >> size && in.get() == ' ') {
+            str.resize(size);
+            in.read(str.data(), size);
+        }
+        return static_cast<bool>(in);
+    };
+    RuleSet cached;
+    for (std::size_t i{0}; i < count; ++i) {
+        char kind;
+        std::string key;
+        Rule rule;
+        if (!(in >> kind) || !field(key) || !field(rule.cmake) || !field(rule.libraries) || !field(rule.flags)) {
+            return false;
+        }
+        // the patterns were valid when the cache was written
+        cached.add(kind, key, std::move(rule), RuleMatcher::Compile::lazily);
+    }
+    *this = std::move(cached);
+    return true;
+}
+
+void RuleSet::writeCache(const fs::path& cachefile) const {
+    std::vector<std::pair<char, std::string>> keys(rules.size());
+    for (const auto& [header, index] : headers) {
+        keys[index] = {'h', header};
+    }
+    for (std::size_t id{0}; id < patterns.size(); ++id) {
+        keys[patterns[id]] = {'r', matcher.pattern(id)};
+    }
+    // concurrent runs never see a partial cache
+    replaceFile(cachefile, [&](const fs::path& tmpfile) {
+        std::ofstream out{tmpfile, std::ios::binary};
+        auto field = [&out](const std::string& str) {
+            out << ' ' << str.size() << ' ' << str;
+        };
+        out << cacheTag << '\n' << VERSION << '\n' << rules.size() << '\n';
+        for (std::size_t i{0}; i < rules.size(); ++i) {
+            out << keys[i].first;
+            field(keys[i].second);
+            field(rules[i].cmake);
+            field(rules[i].libraries);
+            field(rules[i].flags);
+            out << '\n';
+        }
+        out.close();
+        return static_cast<bool>(out);
+    });
+}
+
+std::string_view includedHeader(std::string_view line) {
+    static constexpr std::string_view blanks{" \t"};
+    static constexpr std::string_view directive{"include"};
+    auto pos{line.find_first_not_of(blanks)};
+    if (pos == std::string_view::npos || line[pos] != '#') {
+        return {};
+    }
+    pos = line.find_first_not_of(blanks, pos + 1);
+    if (pos == std::string_view::npos || line.compare(pos, directive.size(), directive) != 0) {
+        return {};
+    }
+    pos = line.find_first_not_of(blanks, pos + directive.size());
+    if (pos == std::string_view::npos || line[pos] != '<') {
+        return {};
+    }
+    const auto end{line.find('>', ++pos)};
+    return end == std::string_view::npos ? std::string_view{} : line.substr(pos, end - pos);
+}
+
+// helper functions
+
+/// returns true if the rule field is a header name such as `<png.h>` rather than a regex
+bool isHeaderRule(std::string_view field) {
+    return field.size() > 2 && field.front() == '<' && field.back() == '>'
+        && field.find_first_of("<>\\()[]|*?", 1) == field.size() - 1;
+}
+
+/// replace each two character sequence "\n" with a newline
+std::string expandNewlines(std::string text) {
+    for (auto pos{text.find("\\n")}; pos != std::string::npos; pos = text.find("\\n", pos + 1)) {
+        text.replace(pos, 2, 1, '\n');
+    }
+    return text;
+}
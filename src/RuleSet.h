@@ -0,0 +1,78 @@
+#ifndef RULESET_H
+#define RULESET_H
+#include "config.h"
+#include "RuleMatcher.h"
+#include <cstddef>
+#include <istream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#if HAS_FILESYSTEM
+#include <filesystem>
+namespace fs = std::filesystem;
+#else
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#endif
+
+/// what a rule adds to the generated project when it is triggered
+struct Rule {
+    std::string cmake;
+    std::string libraries;
+    // compile and link flags for builds without CMake, such as "-pthread" or "-lpng"
+    std::string flags;
+};
+
+/*! The rules of one rules file and the means of finding them.
+ *
+ * Rules keyed by a header name are found by looking up the target of
+ * each `#include` line; all others are found by a RuleMatcher.  A RuleSet
+ * is immutable once constructed, so a single instance may be shared by
+ * any number of concurrent extractions; shared() hands out one instance
+ * per rules file for exactly that purpose.
+ */
+class RuleSet {
+public:
+    /*! load the rules in `rulesfile`.
+     *
+     * If `cachedir` is not empty, the parsed rules are read from or
+     * written to a cache there, keyed by the contents of `rulesfile`;
+     * `rebuildCache` ignores any existing cache entry.
+     */
+    explicit RuleSet(const fs::path& rulesfile, const fs::path& cachedir = {}, bool rebuildCache = false);
+    RuleSet(RuleSet&&) = default;
+    RuleSet& operator=(RuleSet&&) = default;
+    RuleSet(const RuleSet&) = delete;
+    RuleSet& operator=(const RuleSet&) = delete;
+    /// the rule set for `rulesfile`, loaded on first use and shared until the file changes
+    static std::shared_ptr<const RuleSet> shared(const fs::path& rulesfile, const fs::path& cachedir = {}, bool rebuildCache = false);
+    /// ids, in ascending order, of the rules triggered by `line`
+    std::vector<std::size_t> match(std::string_view line) const;
+    /// the rule with the given id; ids follow the order of the rules file
+    const Rule& operator[](std::size_t id) const { return rules[id]; }
+    /// number of rules
+    std::size_t size() const { return rules.size(); }
+
+private:
+    RuleSet() = default;
+    void add(char kind, const std::string& key, Rule rule, RuleMatcher::Compile when);
+    void parse(std::istream& in, const fs::path& rulesfile);
+    bool readCache(const fs::path& cachefile);
+    void writeCache(const fs::path& cachefile) const;
+
+    std::vector<Rule> rules;
+    // header name without the brackets -> index into rules
+    std::unordered_multimap<std::string, std::size_t> headers;
+    RuleMatcher matcher;
+    // matcher rule id -> index into rules
+    std::vector<std::size_t> patterns;
+};
+
+/*! returns the name of the header if `line` is a `#include <header>`
+ * directive, otherwise an empty view.
+ */
+std::string_view includedHeader(std::string_view line);
+#endif // RULESET_H
@@ -0,0 +1,245 @@
+#include "config.h"
+#include "Server.h"
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <iostream>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+Json handleRequest(const Json& request, bool overwrite, const std::map<std::string, LangConfig>& lang) {
+    Json result{Json::object()};
+    const auto start{std::chrono::steady_clock::now()};
+    try {
+        if (request.type() != Json::Type::object) {
+            throw std::runtime_error("request must be a JSON object");
+        }
+        overwrite = request["overwrite"].asBool(overwrite);
+        const bool incremental{request["incremental"].asBool(false)};
+        AutoProject ap;
+        if (request.has("content")) {
+            if (!request["name"].isString()) {
+                throw std::runtime_error("inline content requires a \"name\"");
+            }
+            ap = AutoProject{request["name"].asString(), request["content"].asString(), lang};
+        } else if (request["md"].isString()) {
+            ap = AutoProject{request["md"].asString(), lang};
+        } else {
+            throw std::runtime_error("request must have either \"md\" or \"name\" and \"content\"");
+        }
+        bool ok{ap.createProject(overwrite, incremental)};
+        result.set("ok", ok);
+        result.set("outdir", ap.outputDir().string());
+        result.set("upToDate", ap.upToDate());
+        if (incremental) {
+            result.set("unchanged", ap.unchangedFiles());
+        }
+        Json files{Json::array()};
+        for (const auto& file : ap.sourceFiles()) {
+            files.push_back(file.string());
+        }
+        result.set("files", files);
+        if (!ok) {
+            result.set("error", "no source files found");
+        }
+    }
+    catch (std::exception& e) {
+        result.set("ok", false);
+        result.set("error", e.what());
+    }
+    const std::chrono::duration<double, std::milli> elapsed{std::chrono::steady_clock::now() - start};
+    result.set("ms", elapsed.count());
+    return result;
+}
+
+#ifdef _WIN32
+int serve(const fs::path&, bool, const std::map<std::string, LangConfig>&) {
+    std::cerr << "Error: --serve is not supported on this platform\n";
+    return 1;
+}
+#else
+// local constants
+// a request longer than this is taken to be garbage rather than waited for
+static constexpr std::size_t maxRequest{64 * 1024 * 1024};
+
+static volatile std::sig_atomic_t stopRequested{0};
+
+static void requestStop(int) {
+    stopRequested = 1;
+}
+
+/*! The sockets are closed on exec, so that the commands BuildPool
+ * starts in the background do not hold them open.  Where that cannot be
+ * asked for as a socket is made, it is marked straight after.
+ */
+static int openSocket() {
+#ifdef SOCK_CLOEXEC
+    return socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+#else
+    const int fd{socket(AF_UNIX, SOCK_STREAM, 0)};
+    if (fd >= 0) {
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    return fd;
+#endif
+}
+
+static int acceptConnection(int listener) {
+#ifdef SOCK_CLOEXEC
+    return accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+#else
+    const int fd{accept(listener, nullptr, nullptr)};
+    if (fd >= 0) {
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    return fd;
+#endif
+}
+
+// wait up to half a second for `fd` to become readable
+static bool readable(int fd) {
+    pollfd pfd{fd, POLLIN, 0};
+    return poll(&pfd, 1, 500) > 0;
+}
+
+static bool sendAll(int fd, const std::string& data) {
+    for (std::size_t sent{0}; sent < data.size(); ) {
+        auto n{send(fd, data.data() + sent, data.size() - sent, 0)};
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        sent += n;
+    }
+    return true;
+}
+
+static void serveConnection(int fd, bool overwrite, const std::map<std::string, LangConfig>& lang) {
+    std::string pending;
+    char buffer[65536];
+    while (!stopRequested) {
+        if (!readable(fd)) {
+            continue;
+        }
+        auto n{recv(fd, buffer, sizeof buffer, 0)};
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        pending.append(buffer, n);
+        for (auto eol{pending.find('\n')}; eol != std::string::npos; eol = pending.find('\n')) {
+            std::string line{pending.substr(0, eol)};
+            pending.erase(0, eol + 1);
+            if (line.find_first_not_of(" \t\r") == std::string::npos) {
+                continue;
+            }
+            Json result;
+            try {
+                result = handleRequest(Json::parse(line), overwrite, lang);
+            }
+            catch (JsonError& e) {
+                result.set("ok", false);
+                result.set("error", e.what());
+            }
+            if (!sendAll(fd, result.dump() + '\n')) {
+                close(fd);
+                return;
+            }
+        }
+        if (pending.size() > maxRequest) {
+            Json result{Json::object()};
+            result.set("ok", false);
+            result.set("error", "request longer than " + std::to_string(maxRequest) + " bytes");
+            sendAll(fd, result.dump() + '\n');
+            break;
+        }
+    }
+    close(fd);
+}
+
+int serve(const fs::path& socketpath, bool overwrite, const std::map<std::string, LangConfig>& lang) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    const auto pathname{socketpath.string()};
+    if (pathname.size() >= sizeof addr.sun_path) {
+        std::cerr << "Error: socket path \"" << pathname << "\" is too long\n";
+        return 1;
+    }
+    std::strcpy(addr.sun_path, pathname.c_str());
+    int listener{openSocket()};
+    if (listener < 0) {
+        std::cerr << "Error: cannot create socket: " << std::strerror(errno) << '\n';
+        return 1;
+    }
+    // a stale socket from an earlier run would make bind fail
+    if (fs::is_socket(socketpath)) {
+        fs::remove(socketpath);
+    }
+    if (bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof addr) < 0 || listen(listener, SOMAXCONN) < 0) {
+        std::cerr << "Error: cannot listen on \"" << pathname << "\": " << std::strerror(errno) << '\n';
+        close(listener);
+        return 1;
+    }
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+    // a client hanging up early must not kill the server
+    std::signal(SIGPIPE, SIG_IGN);
+    std::cout << "Listening on " << pathname << std::endl;
+    // each connection has a thread of its own, so that idle clients cannot keep others waiting
+    std::mutex mtx;
+    std::condition_variable closed;
+    std::size_t connections{0};
+    while (!stopRequested) {
+        if (!readable(listener)) {
+            continue;
+        }
+        int fd{acceptConnection(listener)};
+        if (fd < 0) {
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock{mtx};
+            ++connections;
+        }
+        try {
+            std::thread{[fd, overwrite, &lang, &mtx, &closed, &connections]{
+                serveConnection(fd, overwrite, lang);
+                std::lock_guard<std::mutex> lock{mtx};
+                if (--connections == 0) {
+                    closed.notify_all();
+                }
+            }}.detach();
+        }
+        catch (std::system_error& e) {
+            std::cerr << "Error: cannot serve a connection: " << e.what() << '\n';
+            close(fd);
+            std::lock_guard<std::mutex> lock{mtx};
+            --connections;
+        }
+    }
+    {
+        // wait for open connections to notice the stop request
+        std::unique_lock<std::mutex> lock{mtx};
+        closed.wait(lock, [&connections]{ return connections == 0; });
+    }
+    close(listener);
+    fs::remove(socketpath);
+    std::cout << "Stopped listening on " << pathname << '\n';
+    return 0;
+}
+#endif
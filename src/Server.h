@@ -0,0 +1,32 @@
+#ifndef SERVER_H
+#define SERVER_H
+#include "AutoProject.h"
+#include "Json.h"
+#include <map>
+#include <string>
+
+/*! Perform a single extraction request.
+ *
+ * The request is an object naming either an md file on disk
+ * (`"md": "/tmp/248232.md"`) or holding the markdown itself
+ * (`"name": "/tmp/248232.md", "content": "..."`), optionally with
+ * `"overwrite": true|false` to override `overwrite` and `"incremental": true`
+ * to write only the output files whose contents change.  The result is an
+ * object with `"ok"` and either `"outdir"`, `"upToDate"` and `"files"` or
+ * `"error"`; an incremental request also reports the number of
+ * `"unchanged"` files.
+ */
+Json handleRequest(const Json& request, bool overwrite, const std::map<std::string, LangConfig>& lang);
+
+/*! Serve extraction requests on a Unix domain socket until interrupted.
+ *
+ * Each connection carries any number of requests, one JSON object per
+ * line; each is answered with one line containing the JSON result.
+ * Each connection is served on its own thread and all of them share
+ * the already loaded configuration and rules.  A connection whose
+ * pending line grows beyond 64 MiB is answered with an error and closed.
+ *
+ * @return the process exit status
+ */
+int serve(const fs::path& socketpath, bool overwrite, const std::map<std::string, LangConfig>& lang);
+#endif // SERVER_H
@@ -0,0 +1,81 @@
+#include "SharedHeader.h"
+#include "Hash.h"
+#include "Process.h"
+#include "Tool.h"
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+using namespace std::literals;
+
+// local constants
+#ifdef _WIN32
+static constexpr std::string_view nullDevice{"NUL"};
+#else
+static constexpr std::string_view nullDevice{"/dev/null"};
+#endif
+// left in the directory when the compiler cannot precompile the header, so that no one tries again
+static const fs::path failedName{"failed"};
+
+// SharedHeader interface functions
+SharedHeader::SharedHeader(const Tool& compiler, const std::string& flags, const std::string& headers, bool cplusplus, const fs::path& cachedir) {
+    if (cachedir.empty() || headers.empty()) {
+        return;
+    }
+    std::uint64_t hash{fnv1a(compiler.digest())};
+    for (const std::string_view piece : { std::string_view{flags}, std::string_view{headers}, cplusplus ? "c++"sv : "c"sv }) {
+        hash = fnv1a(piece, fnv1a("\n", hash));
+    }
+    const auto dir{cachedir / ("pch-" + hexDigest(hash))};
+    const fs::path candidate{dir / (cplusplus ? "shared.hpp" : "shared.h")};
+    // GCC looks for a .gch beside the header and Clang for a .pch
+    auto pch{candidate};
+    pch += compiler.version.find("clang") == std::string::npos ? ".gch" : ".pch";
+    std::error_code ec;
+    if (fs::exists(dir / failedName, ec)) {
+        return;
+    }
+    if (!fs::exists(candidate, ec) || !fs::exists(pch, ec)) {
+        // concurrent runs never see a partial header
+        const bool written{replaceFile(candidate, [&](const fs::path& tmpheader) {
+            std::ofstream out{tmpheader, std::ios::binary};
+            out << "// precompiled by autoproject for " << compiler.version << '\n';
+            std::istringstream in{headers};
+            for (std::string name; in >> name; ) {
+                out << "#include " << name << '\n';
+            }
+            out.close();
+            return static_cast<bool>(out);
+        })};
+        bool compiled{false};
+        const bool replaced{written && replaceFile(pch, [&](const fs::path& tmppch) {
+            const auto command{shellQuoted(compiler.path) + ' ' + flags + (cplusplus ? " -x c++-header " : " -x c-header ")
+                + shellQuoted(candidate) + " -o " + shellQuoted(tmppch) + " > " + std::string{nullDevice} + " 2>&1"};
+            return compiled = runCommand(command, dir).status == 0;
+        })};
+        if (!written || !compiled) {
+            std::ofstream{dir / failedName};
+            return;
+        }
+        if (!replaced) {
+            return;
+        }
+    }
+    header = candidate;
+    precompiled = pch;
+}
+
+std::shared_ptr<const SharedHeader> SharedHeader::shared(const Tool& compiler, const std::string& flags, const std::string& headers, bool cplusplus, const fs::path& cachedir) {
+    static std::mutex mtx;
+    static std::map<std::string, std::shared_ptr<const SharedHeader>> built;
+    // held while building, so that the other threads of a batch wait for the one header rather than each building it
+    std::lock_guard<std::mutex> lock{mtx};
+    // keyed on the compiler's digest, so that an upgraded compiler gets a header of its own
+    auto& result{built[compiler.digest() + '\n' + flags + '\n' + headers + (cplusplus ? "\nc++" : "\nc")]};
+    if (!result) {
+        result = std::make_shared<const SharedHeader>(compiler, flags, headers, cplusplus, cachedir);
+    }
+    // a header that could not be built is remembered too, so that it is only tried once
+    return result->header.empty() ? nullptr : result;
+}
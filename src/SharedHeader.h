@@ -0,0 +1,48 @@
+#ifndef SHAREDHEADER_H
+#define SHAREDHEADER_H
+#include "config.h"
+#include <memory>
+#include <string>
+
+#if HAS_FILESYSTEM
+#include <filesystem>
+namespace fs = std::filesystem;
+#else
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#endif
+
+class Tool;
+
+/*! A header of common system headers, precompiled once for every project.
+ *
+ * Nearly every project includes the same few standard headers, and
+ * parsing them is most of the work of compiling a small source.  The
+ * header and its precompiled form live in the cache directory, in a
+ * directory named for the digest of the compiler, its flags and the
+ * headers, so a project built with the same compiler and flags can
+ * include it ahead of every source and skip that work.  A different
+ * compiler version or different flags simply get a directory of their
+ * own.
+ *
+ * Only GCC and Clang are supported; each finds the precompiled file
+ * beside a header given with `-include` by itself, and falls back to
+ * the header if the precompiled file does not suit.
+ */
+class SharedHeader {
+public:
+    /*! build the header of `headers`, e.g. "<iostream> <vector>", for
+     * `compiler` with `flags`, unless it is already in `cachedir`.
+     *
+     * If it cannot be built, `header` is empty.
+     */
+    SharedHeader(const Tool& compiler, const std::string& flags, const std::string& headers, bool cplusplus, const fs::path& cachedir);
+    /// the header for these arguments, built on first use and shared thereafter; nullptr if it cannot be built
+    static std::shared_ptr<const SharedHeader> shared(const Tool& compiler, const std::string& flags, const std::string& headers, bool cplusplus, const fs::path& cachedir);
+
+    /// the header to include ahead of every source
+    fs::path header;
+    /// its precompiled form
+    fs::path precompiled;
+};
+#endif // SHAREDHEADER_H
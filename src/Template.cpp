@@ -0,0 +1,85 @@
+#include "Template.h"
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+// local constants
+static constexpr std::string_view placeholders[Template::fields]{
+    "{projname}", "{srcnames}", "{extras}", "{libraries}", "{precompiled}", "{programs}",
+};
+
+// Template interface functions
+Template::Template(std::string_view source) :
+    text{source}
+{
+    if (!text.empty() && text.back() != '\n') {
+        text += '\n';
+    }
+    const std::string_view view{text};
+    std::size_t start{0};
+    for (auto pos{view.find('{')}; pos != std::string_view::npos; pos = view.find('{', pos + 1)) {
+        for (std::size_t field{0}; field < fields; ++field) {
+            if (view.compare(pos, placeholders[field].size(), placeholders[field]) == 0) {
+                if (pos > start) {
+                    tokens.push_back({Field::literal, view.substr(start, pos - start)});
+                }
+                tokens.push_back({static_cast<Field>(field), {}});
+                start = pos + placeholders[field].size();
+                pos = start - 1;
+                break;
+            }
+        }
+    }
+    if (start < view.size()) {
+        tokens.push_back({Field::literal, view.substr(start)});
+    }
+    for (const auto& token : tokens) {
+        literalSize += token.text.size();
+    }
+}
+
+std::shared_ptr<const Template> Template::shared(const fs::path& filename) {
+    struct Loaded {
+        std::uintmax_t size = 0;
+        fs::file_time_type time{};
+        std::shared_ptr<const Template> tmpl;
+    };
+    static std::mutex mtx;
+    static std::map<fs::path, Loaded> loaded;
+    std::error_code ec;
+    const auto size{fs::file_size(filename, ec)};
+    const auto time{ec ? fs::file_time_type{} : fs::last_write_time(filename, ec)};
+    std::lock_guard<std::mutex> lock{mtx};
+    auto& entry{loaded[filename]};
+    if (!entry.tmpl || entry.size != size || entry.time != time) {
+        std::ifstream in{filename, std::ios::binary};
+        if (ec || !in) {
+            loaded.erase(filename);
+            return nullptr;
+        }
+        std::stringstream contents;
+        contents << in.rdbuf();
+        entry = {size, time, std::make_shared<const Template>(contents.str())};
+    }
+    return entry.tmpl;
+}
+
+void Template::render(std::string& out, const Values& values) const {
+    std::size_t size{out.size() + literalSize};
+    for (const auto& token : tokens) {
+        if (token.field != Field::literal) {
+            size += values[static_cast<std::size_t>(token.field)].size();
+        }
+    }
+    out.reserve(size);
+    for (const auto& token : tokens) {
+        out += token.field == Field::literal ? token.text : values[static_cast<std::size_t>(token.field)];
+    }
+}
+
+std::string Template::render(const Values& values) const {
+    std::string out;
+    render(out, values);
+    return out;
+}
@@ -0,0 +1,55 @@
+#ifndef TEMPLATE_H
+#define TEMPLATE_H
+#include "config.h"
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if HAS_FILESYSTEM
+#include <filesystem>
+namespace fs = std::filesystem;
+#else
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#endif
+
+/*! A CMake template such as srclevel.cmake.txt, parsed once.
+ *
+ * The text is split into literal pieces and the placeholders `{projname}`,
+ * `{srcnames}`, `{extras}`, `{libraries}`, `{precompiled}` and `{programs}`, so that rendering is a
+ * single pass of appends.  Any other text in braces is left as it is.
+ * Like the line-by-line substitution it replaces, rendering ends every
+ * line, including the last, with a newline.
+ */
+class Template {
+public:
+    enum class Field { projname, srcnames, extras, libraries, precompiled, programs, literal };
+    static constexpr std::size_t fields{static_cast<std::size_t>(Field::literal)};
+    /// the value of each field, indexed by Field
+    using Values = std::array<std::string_view, fields>;
+
+    explicit Template(std::string_view text);
+    // the tokens point into text, so a Template stays where it was made
+    Template(const Template&) = delete;
+    Template& operator=(const Template&) = delete;
+    /// the template in `filename`, read on first use and shared until the file changes; nullptr if it cannot be read
+    static std::shared_ptr<const Template> shared(const fs::path& filename);
+    /// append the template to `out` with each placeholder replaced by its value
+    void render(std::string& out, const Values& values) const;
+    std::string render(const Values& values) const;
+
+private:
+    struct Token {
+        Field field;
+        // the text, if field is Field::literal
+        std::string_view text;
+    };
+
+    std::string text;
+    std::vector<Token> tokens;
+    std::size_t literalSize = 0;
+};
+#endif // TEMPLATE_H
@@ -0,0 +1,166 @@
+#include "Tool.h"
+#include "Hash.h"
+#include "Process.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string_view>
+#include <utility>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+// local constants
+static constexpr std::string_view cacheTag{"autoproject tool cache"};
+
+// helper functions
+static fs::path findProgram(const std::string& name);
+static std::string firstLineOf(const std::string& command);
+
+// Tool interface functions
+Tool::Tool(const std::string& name, const fs::path& cachedir) :
+    path{findProgram(name)}
+{
+    if (path.empty()) {
+        return;
+    }
+    std::error_code ec;
+    size = fs::file_size(path, ec);
+    time = static_cast<long long>(fs::last_write_time(path, ec).time_since_epoch().count());
+    fs::path cachefile;
+    if (!cachedir.empty()) {
+        cachefile = cachedir / ("tool-" + hexDigest(fnv1a(path.string())) + ".cache");
+    }
+    if (cachefile.empty() || !readCache(cachefile)) {
+        version = firstLineOf(shellQuoted(path) + " --version");
+        if (!cachefile.empty()) {
+            writeCache(cachefile);
+        }
+    }
+}
+
+/*! A program found before is probed again if its size or modification
+ * time has changed since, e.g. because the compiler was upgraded.
+ */
+std::shared_ptr<const Tool> Tool::shared(const std::string& name, const fs::path& cachedir) {
+    static std::mutex mtx;
+    static std::map<std::pair<std::string, fs::path>, std::shared_ptr<const Tool>> found;
+    const std::pair<std::string, fs::path> key{name, cachedir};
+    std::lock_guard<std::mutex> lock{mtx};
+    auto& tool{found[key]};
+    if (tool) {
+        std::error_code ec;
+        const auto size{fs::file_size(tool->path, ec)};
+        const auto time{static_cast<long long>(fs::last_write_time(tool->path, ec).time_since_epoch().count())};
+        if (ec || size != tool->size || time != tool->time) {
+            tool.reset();
+        }
+    }
+    if (!tool) {
+        auto probed{std::make_shared<const Tool>(name, cachedir)};
+        if (probed->path.empty()) {
+            found.erase(key);
+            return nullptr;
+        }
+        tool = std::move(probed);
+    }
+    return tool;
+}
+
+std::string Tool::digest() const {
+    return hexDigest(fnv1a(version, fnv1a("\n", fnv1a(path.string()))));
+}
+
+/*! The tool cache is a line of `cacheTag` followed by a line each for the
+ * path, the size, the modification time and the version.
+ */
+bool Tool::readCache(const fs::path& cachefile) {
+    std::ifstream in{cachefile, std::ios::binary};
+    std::string line;
+    if (!std::getline(in, line) || line != cacheTag || !std::getline(in, line) || line != path.string()) {
+        return false;
+    }
+    std::uintmax_t cachedSize;
+    long long cachedTime;
+    if (!(in >> cachedSize >> cachedTime) || cachedSize != size || cachedTime != time) {
+        return false;
+    }
+    in.ignore(1);
+    return static_cast<bool>(std::getline(in, version));
+}
+
+void Tool::writeCache(const fs::path& cachefile) const {
+    // concurrent runs never see a partial cache
+    replaceFile(cachefile, [&](const fs::path& tmpfile) {
+        std::ofstream out{tmpfile, std::ios::binary};
+        out << cacheTag << '\n' << path.string() << '\n' << size << '\n' << time << '\n' << version << '\n';
+        out.close();
+        return static_cast<bool>(out);
+    });
+}
+
+// helper functions
+
+/// returns the absolute path of the executable `name`, searching the PATH unless it has a directory, or else an empty path
+fs::path findProgram(const std::string& name) {
+#ifdef _WIN32
+    static constexpr char separator{';'};
+    static constexpr std::string_view suffixes[]{"", ".exe"};
+#else
+    static constexpr char separator{':'};
+    static constexpr std::string_view suffixes[]{""};
+#endif
+    auto runnable = [](const fs::path& candidate) {
+        std::error_code ec;
+        const auto status{fs::status(candidate, ec)};
+        return !ec && fs::is_regular_file(status)
+            && (status.permissions() & (fs::perms::owner_exec | fs::perms::group_exec | fs::perms::others_exec)) != fs::perms::none;
+    };
+    if (name.empty()) {
+        return {};
+    }
+    const fs::path program{name};
+    if (program.has_parent_path()) {
+        return runnable(program) ? fs::absolute(program) : fs::path{};
+    }
+    const char *env{std::getenv("PATH")};
+    for (std::string_view dirs{env ? env : ""}; !dirs.empty(); ) {
+        const auto end{std::min(dirs.find(separator), dirs.size())};
+        const fs::path dir{std::string{dirs.substr(0, end)}};
+        dirs.remove_prefix(std::min(end + 1, dirs.size()));
+        for (const auto suffix : suffixes) {
+            const auto candidate{dir / (name + std::string{suffix})};
+            if (!dir.empty() && runnable(candidate)) {
+                return fs::absolute(candidate);
+            }
+        }
+    }
+    return {};
+}
+
+/// runs `command` and returns the first line it writes, without the line ending
+std::string firstLineOf(const std::string& command) {
+    FILE *pipe{popen((command + " 2>&1").c_str(), "r")};
+    if (!pipe) {
+        return {};
+    }
+    std::string line;
+    bool complete{false};
+    char buffer[256];
+    while (std::fgets(buffer, sizeof buffer, pipe)) {
+        if (!complete) {
+            line += buffer;
+            complete = !line.empty() && line.back() == '\n';
+        }
+    }
+    pclose(pipe);
+    while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) {
+        line.pop_back();
+    }
+    return line;
+}
@@ -0,0 +1,50 @@
+#ifndef TOOL_H
+#define TOOL_H
+#include "config.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#if HAS_FILESYSTEM
+#include <filesystem>
+namespace fs = std::filesystem;
+#else
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#endif
+
+/*! A program, such as a compiler or linker, found on the PATH.
+ *
+ * Finding a program means searching the PATH and then running it with
+ * `--version` to learn what it is.  That is done at most once per
+ * process for each name and the answer is kept in the cache directory,
+ * where it stays good for as long as the program's size and
+ * modification time are unchanged.
+ */
+class Tool {
+public:
+    /*! find the program `name`, which may also be a path.
+     *
+     * If `cachedir` is not empty, the version is read from or written to
+     * a cache there.  If the program cannot be found, `path` is empty.
+     */
+    explicit Tool(const std::string& name, const fs::path& cachedir = {});
+    /// the program `name`, found on first use and shared until it changes; nullptr if it cannot be found
+    static std::shared_ptr<const Tool> shared(const std::string& name, const fs::path& cachedir = {});
+    /// digest of the path and the version, which changes whenever the program does
+    std::string digest() const;
+
+    /// absolute path of the program
+    fs::path path;
+    /// first line of the program's `--version` output
+    std::string version;
+
+private:
+    bool readCache(const fs::path& cachefile);
+    void writeCache(const fs::path& cachefile) const;
+
+    std::uintmax_t size = 0;
+    // modification time, as a count of file_time_type ticks
+    long long time = 0;
+};
+#endif // TOOL_H
@@ -0,0 +1,151 @@
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*! A small work-stealing thread pool.
+ *
+ * Each worker owns a queue.  Submitted tasks are dealt round-robin to
+ * the queues; a worker takes tasks from the front of its own queue and,
+ * when that runs dry, steals from the back of the other workers' queues.
+ * This keeps all workers busy even when task durations vary widely, as
+ * they do for markdown files of very different sizes.
+ */
+class WorkPool {
+public:
+    using Task = std::function<void()>;
+
+    explicit WorkPool(unsigned threads = std::thread::hardware_concurrency()) {
+        if (threads == 0) {
+            threads = 1;
+        }
+        for (unsigned i{0}; i < threads; ++i) {
+            queues.emplace_back(std::make_unique<Queue>());
+        }
+        try {
+            for (unsigned i{0}; i < threads; ++i) {
+                workers.emplace_back([this, i]{ run(i); });
+            }
+        }
+        catch (...) {
+            // the destructor will not run, so stop the workers already started
+            stop();
+            throw;
+        }
+    }
+
+    WorkPool(const WorkPool&) = delete;
+    WorkPool& operator=(const WorkPool&) = delete;
+
+    ~WorkPool() {
+        stop();
+    }
+
+    /// queue `task` for execution on one of the workers; `task` must not throw
+    void submit(Task task) {
+        auto& queue{*queues[next++ % queues.size()]};
+        {
+            std::lock_guard<std::mutex> lock{mtx};
+            ++queued;
+            ++pending;
+        }
+        {
+            std::lock_guard<std::mutex> lock{queue.mtx};
+            queue.tasks.push_back(std::move(task));
+        }
+        available.notify_one();
+    }
+
+    /// block until every submitted task has finished
+    void wait() {
+        std::unique_lock<std::mutex> lock{mtx};
+        idle.wait(lock, [this]{ return pending == 0; });
+    }
+
+    /// the number of worker threads
+    std::size_t size() const { return workers.size(); }
+
+private:
+    struct Queue {
+        std::mutex mtx;
+        std::deque<Task> tasks;
+    };
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock{mtx};
+            stopping = true;
+        }
+        available.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    bool take(std::size_t self, Task& task) {
+        // own queue first, oldest task first
+        {
+            auto& queue{*queues[self]};
+            std::lock_guard<std::mutex> lock{queue.mtx};
+            if (!queue.tasks.empty()) {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+                return true;
+            }
+        }
+        // then steal the newest task from somebody else
+        for (std::size_t i{1}; i < queues.size(); ++i) {
+            auto& queue{*queues[(self + i) % queues.size()]};
+            std::lock_guard<std::mutex> lock{queue.mtx};
+            if (!queue.tasks.empty()) {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run(std::size_t self) {
+        for (;;) {
+            Task task;
+            if (take(self, task)) {
+                {
+                    std::lock_guard<std::mutex> lock{mtx};
+                    --queued;
+                }
+                task();
+                std::lock_guard<std::mutex> lock{mtx};
+                if (--pending == 0) {
+                    idle.notify_all();
+                }
+                continue;
+            }
+            std::unique_lock<std::mutex> lock{mtx};
+            // queued is raised before a task is pushed, so a task
+            // submitted since take() failed is never missed here
+            available.wait(lock, [this]{ return stopping || queued > 0; });
+            if (stopping && queued == 0) {
+                return;
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<std::size_t> next{0};
+    std::mutex mtx;
+    std::condition_variable available;
+    std::condition_variable idle;
+    std::size_t queued{0};   // tasks waiting in a queue
+    std::size_t pending{0};  // tasks queued or running
+    bool stopping{false};
+};
+#endif // WORKPOOL_H
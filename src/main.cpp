@@ -1,10 +1,30 @@
 #include "config.h"
 #include "AutoProject.h"
 #include "ConfigFile.h"
+#include "Batch.h"
+#include "Matrix.h"
+#include "NativeHost.h"
+#include "ObjectCache.h"
+#include "Pgo.h"
+#include "Server.h"
+#include "Tool.h"
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
+#include <limits>
 #include <string>
 #include <string_view>
 #include <map>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
 
 constexpr std::string_view license{R"(
 
@@ -36,28 +56,175 @@ constexpr std::string_view license{R"(
 
 static const std::string defaultconfigfilename{DATAFILE_DIR "/config/autoproject.conf"};
 static constexpr std::string_view version{"autoproject " VERSION};
-static constexpr std::string_view usage{"Usage: autoproject project.md\n"
-    "Creates a CMake build tree under 'project' subdirectory\n"};
+// more threads than this many per core only cost memory
+static constexpr unsigned maxJobsPerCore{4};
+static constexpr std::string_view usage{"Usage: autoproject [--incremental] [--unity [--unity-skip FILES]] [--profile P] [--pgo|--matrix] [--training CMD] project.md\n"
+    "       autoproject [--jobs N] file.md|dir ...\n"
+    "       autoproject --serve socketpath\n"
+    "       autoproject --native-host\n"
+    "       autoproject --cache-stats\n"
+    "Creates a CMake build tree under 'project' subdirectory\n"
+    "With several inputs, a directory or --jobs, every md file is processed\n"
+    "on a pool of N threads (default: one per core, at most four per core)\n"
+    "With --serve, answers JSON requests on a Unix domain socket until interrupted\n"
+    "With --native-host, acts as the browser extension's native messaging host\n"
+    "With --incremental, an existing project is updated, rewriting only the\n"
+    "files whose contents change so that a rebuild does only what is needed\n"
+    "With --rebuild-rule-cache, parses the rules files afresh instead of using the cache\n"
+    "and probes the toolchain again if its initial cache could not be made before\n"
+    "With --generator ninja or --generator make, also writes a build.ninja or\n"
+    "Makefile that builds the project directly, with no CMake configure step\n"
+    "With --unity, the CMake build compiles the sources together as a unity\n"
+    "build, apart from any whose file-local definitions might clash and the\n"
+    "sources named in --unity-skip, e.g. \"board.cpp game.cpp\"\n"
+    "With --profile debug, release, native or lto, C and C++ projects are\n"
+    "built with that optimization profile in a build-<profile> directory\n"
+    "With --pgo, the project is then built with profile-guided optimization,\n"
+    "trained by running it with the arguments CMD, and its runtime compared\n"
+    "with the plain build of the profile, which defaults to release\n"
+    "With --matrix, the project is built with each configured compiler at\n"
+    "each optimization level, and the build time, size and runtime of each\n"
+    "are compared, running the program with the arguments CMD\n"
+    "With --cache-stats, reports how many compiles the object cache served\n"
+    "since the last report, e.g. for the builds of the last batch, and starts\n"
+    "counting afresh\n"};
+
+// the per-user cache directory, following the XDG convention where it applies
+static fs::path defaultCacheDir() {
+    if (const char *xdg{std::getenv("XDG_CACHE_HOME")}; xdg && *xdg) {
+        return fs::path{xdg} / "autoproject";
+    }
+#ifdef _WIN32
+    if (const char *local{std::getenv("LOCALAPPDATA")}; local && *local) {
+        return fs::path{local} / "autoproject" / "cache";
+    }
+#else
+    if (const char *home{std::getenv("HOME")}; home && *home) {
+        return fs::path{home} / ".cache" / "autoproject";
+    }
+#endif
+    return fs::temp_directory_path() / "autoproject-cache";
+}
+
+// the optimization profile named `name`, or nothing if there is no such profile
+static std::optional<Profile> profileNamed(const std::string& name) {
+    static const std::map<std::string, Profile> profiles{
+        { "debug", Profile::debug },
+        { "release", Profile::release },
+        { "native", Profile::native },
+        { "lto", Profile::lto },
+    };
+    auto it{profiles.find(name)};
+    return it == profiles.end() ? std::nullopt : std::optional<Profile>{it->second};
+}
+
+// the generator named `name`, or nothing if there is no such generator
+static std::optional<Generator> generatorNamed(const std::string& name) {
+    static const std::map<std::string, Generator> generators{
+        { "cmake", Generator::cmake },
+        { "ninja", Generator::ninja },
+        { "make", Generator::make },
+    };
+    auto it{generators.find(name)};
+    return it == generators.end() ? std::nullopt : std::optional<Generator>{it->second};
+}
+
+// the cache directory configured in `cfg`
+static fs::path cacheDir(const ConfigFile &cfg) {
+    return cfg.has_value("General", "CacheDir") ? fs::path{cfg.get_value("General", "CacheDir")} : defaultCacheDir();
+}
+
+// the absolute path of this program, invoked as `argv0`, or nothing if it cannot be found
+static fs::path programPath(const char *argv0) {
+    std::error_code ec;
+#ifndef _WIN32
+    if (const auto self{fs::read_symlink("/proc/self/exe", ec)}; !ec) {
+        return self;
+    }
+#endif
+    const fs::path invoked{argv0};
+    if (invoked.has_parent_path()) {
+        return fs::absolute(invoked, ec);
+    }
+    const auto tool{Tool::shared(invoked.string())};
+    return tool ? tool->path : fs::path{};
+}
 
 std::map<std::string, LangConfig> fetchLanguageSettings(const ConfigFile &cfg) {
     std::map<std::string, LangConfig> lang;
     auto configfiledir = cfg.get_value("General", "ConfigFileDir");
+    const fs::path cachedir{cacheDir(cfg)};
     for (const auto& section : cfg) {
         if (section.first != "general") {
             fs::path basedir = lang[section.first].configdir = configfiledir + "/" + cfg.get_value(section.first, "Subdir");
             lang[section.first].rulesfilename = basedir / cfg.get_value(section.first, "RulesFileName");
             lang[section.first].toplevelcmakefilename = basedir / cfg.get_value(section.first, "TopLevelCMakeFileName");
             lang[section.first].srclevelcmakefilename = basedir / cfg.get_value(section.first, "SrcLevelCMakeFileName");
+            lang[section.first].cachedir = cachedir;
             if (cfg.has_value(section.first, "CloneDir")) {
                 lang[section.first].clonedir = cfg.get_value(section.first, "CloneDir");
             }
+            if (cfg.has_value(section.first, "Compiler")) {
+                lang[section.first].compiler = cfg.get_value(section.first, "Compiler");
+            }
+            if (cfg.has_value(section.first, "CompileFlags")) {
+                lang[section.first].compileflags = cfg.get_value(section.first, "CompileFlags");
+            }
+            if (cfg.has_value(section.first, "Linker")) {
+                lang[section.first].linker = cfg.get_value(section.first, "Linker");
+            }
+            if (cfg.has_value(section.first, "SharedHeaders")) {
+                lang[section.first].sharedheaders = cfg.get_value(section.first, "SharedHeaders");
+            }
         }
     }
     return lang;
 }
 
+// the blank separated words of `text`, or of `fallback` if there are none
+static std::vector<std::string> words(const std::string& text, const std::string& fallback) {
+    std::vector<std::string> result;
+    std::istringstream in{text};
+    for (std::string word; in >> word; ) {
+        result.push_back(word);
+    }
+    return result.empty() && !fallback.empty() ? words(fallback, {}) : result;
+}
+
+// true if invoked with --native-host or launched by the browser for the extension
+static bool isNativeHost(int argc, char *argv[]) {
+    for (int i=1; i < argc; ++i) {
+        std::string_view arg{argv[i]};
+        if (arg == "--native-host" || arg == extensionId || arg.substr(0, 19) == "chrome-extension://") {
+            return true;
+        }
+    }
+    return false;
+}
+
 int main(int argc, char *argv[]) {
+    // the build files of a project run each compile through this program as a launcher
+    if (argc > 3 && std::string_view{argv[1]} == "--object-cache") {
+        return ObjectCache{argv[2]}.compile({argv + 3, argv + argc});
+    }
     std::string configfile{defaultconfigfilename};
+    // in native messaging mode stdout carries the protocol, so everything
+    // else written to std::cout must go to stderr from the very start
+    std::ostream nativeOut{std::cout.rdbuf()};
+    const bool nativeHost{isNativeHost(argc, argv)};
+    if (nativeHost) {
+        std::cout.rdbuf(std::cerr.rdbuf());
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    }
+    std::string jobs;
+    std::string socketpath;
+    std::string generator;
+    std::string profile;
+    std::string training;
+    std::string unityskip;
 
     struct {
         std::string configfiledir;
@@ -65,6 +232,13 @@ int main(int argc, char *argv[]) {
         bool license = false;
         bool help = false;
         bool version = false;
+        bool nativeHost = false;
+        bool rebuildRuleCache = false;
+        bool incremental = false;
+        bool unity = false;
+        bool pgo = false;
+        bool matrix = false;
+        bool cacheStats = false;
         std::map<std::string, LangConfig> lang;
     } configuration;
 
@@ -74,25 +248,45 @@ int main(int argc, char *argv[]) {
         { "--license", configuration.license },
         { "--help", configuration.help },
         { "--version", configuration.version },
+        { "--native-host", configuration.nativeHost },
+        { "--rebuild-rule-cache", configuration.rebuildRuleCache },
+        { "--incremental", configuration.incremental },
+        { "--unity", configuration.unity },
+        { "--pgo", configuration.pgo },
+        { "--matrix", configuration.matrix },
+        { "--cache-stats", configuration.cacheStats },
     };
     // TODO: use this to allow override of configuration file
     std::map<std::string, std::string&> stringargs{
         { "--configfile", configfile},
+        { "--jobs", jobs},
+        { "--serve", socketpath},
+        { "--generator", generator},
+        { "--profile", profile},
+        { "--training", training},
+        { "--unity-skip", unityskip},
     };
     std::map<std::string, std::string> shortboolargs{
         { "-f", "--forceoverwrite" },
         { "-L", "--license" },
         { "-h", "--help" },
         { "-v", "--version" },
+        { "-i", "--incremental" },
+        { "-u", "--unity" },
     };
     std::map<std::string, std::string> shortstringargs{
         { "-c", "--configfile" },
+        { "-j", "--jobs" },
+        { "-g", "--generator" },
+        { "-p", "--profile" },
     };
     // TODO: make a more rational system for command line args
     // Specifically, command line args should override config file.
     // What's the best way to do that?
     int processed_args{0};
+    std::vector<fs::path> inputs;
     for (int i=1; i < argc; ++i) {
+        const int already_processed{processed_args};
         // std::cout << "argv[" << i << "] = " << argv[i] << ", processed_args = " << processed_args << '\n';
         auto option = boolargs.find(argv[i]);
         if (option != boolargs.end()) {
@@ -104,6 +298,10 @@ int main(int argc, char *argv[]) {
         auto stroption = stringargs.find(argv[i]);
         if (stroption != stringargs.end()) {
             std::cout << "Found option " << stroption->first << '\n';
+            if (i + 1 >= argc) {
+                std::cerr << "Error: " << stroption->first << " needs a value\n" << usage;
+                return 1;
+            }
             stroption->second = argv[++i];
             processed_args += 2;
         }
@@ -118,11 +316,19 @@ int main(int argc, char *argv[]) {
 
         auto shortstroption = shortstringargs.find(argv[i]);
         if (shortstroption != shortstringargs.end()) {
-            std::cout << "Found option " << shortoption->first << '\n';
+            std::cout << "Found option " << shortstroption->first << '\n';
             stroption = stringargs.find(shortstroption->second);
+            if (i + 1 >= argc) {
+                std::cerr << "Error: " << shortstroption->first << " needs a value\n" << usage;
+                return 1;
+            }
             stroption->second = argv[++i];
             processed_args += 2;
         }
+
+        if (processed_args == already_processed) {
+            inputs.emplace_back(argv[i]);
+        }
     }
     if (configuration.license) {
         std::cout << license;
@@ -151,9 +357,124 @@ int main(int argc, char *argv[]) {
             configuration.forceOverwrite = true;
         }
     }
+    if (!configuration.unity) {
+        auto unity{cfg.get_value("General", "UnityBuild")};
+        configuration.unity = unity == "true" || unity == "TRUE" || unity == "True";
+    }
     configuration.lang = fetchLanguageSettings(cfg);
+    if (generator.empty() && cfg.has_value("General", "Generator")) {
+        generator = cfg.get_value("General", "Generator");
+    }
+    const auto backend{generatorNamed(generator.empty() ? "cmake" : generator)};
+    if (!backend) {
+        std::cerr << "Error: unknown generator \"" << generator << "\"; use cmake, ninja or make\n";
+        return 1;
+    }
+    if (profile.empty() && cfg.has_value("General", "Profile")) {
+        profile = cfg.get_value("General", "Profile");
+    }
+    auto optimization{profile.empty() ? std::optional<Profile>{Profile::none} : profileNamed(profile)};
+    if (!optimization) {
+        std::cerr << "Error: unknown profile \"" << profile << "\"; use debug, release, native or lto\n";
+        return 1;
+    }
+    if (configuration.pgo && *optimization == Profile::debug) {
+        std::cerr << "Error: profile-guided optimization needs an optimizing profile\n";
+        return 1;
+    }
+    if (configuration.pgo && *optimization == Profile::none) {
+        optimization = Profile::release;
+    }
+    unsigned buildpool{0};
+    if (cfg.has_value("General", "BuildPool")) {
+        try {
+            buildpool = std::stoul(cfg.get_value("General", "BuildPool"));
+        }
+        catch(std::exception& e) {
+            std::cerr << "Error: invalid build pool size \"" << cfg.get_value("General", "BuildPool") << "\"\n";
+            return 1;
+        }
+    }
+    bool initialcache{true};
+    if (auto probe{cfg.get_value("General", "InitialCache")}; probe == "false" || probe == "FALSE" || probe == "False") {
+        initialcache = false;
+    }
+    fs::path objectcache;
+    if (auto cache{cfg.get_value("General", "ObjectCache")}; cache == "true" || cache == "TRUE" || cache == "True") {
+        objectcache = programPath(argv[0]);
+        if (objectcache.empty()) {
+            std::cerr << "Error: cannot find this program to run compiles through the object cache\n";
+            return 1;
+        }
+    }
+    if (configuration.cacheStats) {
+        const ObjectCache cache{cacheDir(cfg)};
+        const auto stats{cache.stats()};
+        const auto compiles{stats.hits + stats.misses};
+        std::cout << "Object cache " << cache.dir.string() << ": " << stats.hits << " hits, " << stats.misses << " misses";
+        if (compiles) {
+            std::cout << ", " << (100 * stats.hits + compiles / 2) / compiles << "% hit rate";
+        }
+        std::cout << '\n';
+        cache.resetStats();
+        return 0;
+    }
+    if (unityskip.empty() && cfg.has_value("General", "UnitySkip")) {
+        unityskip = cfg.get_value("General", "UnitySkip");
+    }
+    if (training.empty() && cfg.has_value("General", "TrainingCommand")) {
+        training = cfg.get_value("General", "TrainingCommand");
+    }
+    for (auto& entry : configuration.lang) {
+        entry.second.rebuildRuleCache = configuration.rebuildRuleCache;
+        entry.second.generator = *backend;
+        entry.second.profile = *optimization;
+        entry.second.unity = configuration.unity;
+        entry.second.unityskip = unityskip;
+        entry.second.initialcache = initialcache;
+        entry.second.buildpool = buildpool;
+        entry.second.objectcache = objectcache;
+    }
 
-    if (argc - processed_args != 2) {
+    if (nativeHost) {
+        return runNativeHost(std::cin, nativeOut, configuration.forceOverwrite, configuration.lang);
+    }
+    if (!socketpath.empty()) {
+        return serve(socketpath, configuration.forceOverwrite, configuration.lang);
+    }
+    if (inputs.size() > 1 || !jobs.empty() || (inputs.size() == 1 && fs::is_directory(inputs.front()))) {
+        if (configuration.pgo || configuration.matrix) {
+            std::cerr << "Error: --pgo and --matrix build a single project\n";
+            return 1;
+        }
+        unsigned long threads{0};
+        try {
+            if (jobs.find_first_not_of("0123456789") != std::string::npos) {
+                throw std::invalid_argument(jobs);
+            }
+            threads = jobs.empty() ? 0 : std::stoul(jobs);
+            if (threads > std::numeric_limits<unsigned>::max()) {
+                throw std::out_of_range(jobs);
+            }
+        }
+        catch(std::exception& e) {
+            std::cerr << "Error: invalid number of jobs \"" << jobs << "\"\n";
+            return 1;
+        }
+        const unsigned cores{std::max(std::thread::hardware_concurrency(), 1u)};
+        if (threads == 0) {
+            threads = cores;
+        }
+        threads = std::min<unsigned long>(threads, maxJobsPerCore * cores);
+        try {
+            return runBatch(inputs, threads, configuration.forceOverwrite, configuration.incremental, configuration.lang) ? 1 : 0;
+        }
+        catch(std::system_error& e) {
+            std::cerr << "Error: cannot start " << threads << " threads: " << e.what() << '\n';
+            return 1;
+        }
+    }
+    if (inputs.size() != 1) {
         std::cerr << usage; 
         for (int i=processed_args+1; i < argc; ++i) {
             std::cout << "argv[" << i << "] = \"" << argv[i] << "\"\n";
@@ -162,15 +483,22 @@ int main(int argc, char *argv[]) {
     }
     AutoProject ap;
     try {
-        ap.open(argv[processed_args + 1], configuration.lang);
+        ap.open(inputs.front(), configuration.lang);
     }
     catch(std::exception& e) {
         std::cerr << "Error: " << e.what() << '\n';
         return 1;
     }
     try {
-        if (ap.createProject(configuration.forceOverwrite)) {
+        if (ap.createProject(configuration.forceOverwrite, configuration.incremental)) {
             std::cout << ap;   // print final status
+            if (configuration.pgo) {
+                return runPgo(ap, training, std::cout);
+            }
+            if (configuration.matrix) {
+                return runMatrix(ap, words(cfg.get_value(ap.language(), "MatrixCompilers"), ap.language() == "c" ? "gcc clang" : "g++ clang++"),
+                    words(cfg.get_value("General", "MatrixLevels"), "-O1 -O2 -O3 -Os"), training, std::thread::hardware_concurrency(), std::cout);
+            }
         }
     }
     catch(std::exception& e) {
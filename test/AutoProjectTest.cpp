@@ -1,8 +1,12 @@
+#include <cstdlib>
 #include <iostream>
+#include <fstream>
 #include <iomanip>
 #include <string>
 #include <sstream>
 #include <stdexcept>
+#include <thread>
+#include <vector>
 #include <cppunit/TestRunner.h>
 #include <cppunit/extensions/HelperMacros.h>
 #include <cppunit/extensions/TestFactoryRegistry.h>
@@ -13,14 +17,564 @@
 class AutoProjectTest : public CppUnit::TestFixture {
     CPPUNIT_TEST_SUITE(AutoProjectTest);
     CPPUNIT_TEST(sourceFilename);
+    CPPUNIT_TEST(missingTemplate);
+    CPPUNIT_TEST(headerRules);
+    CPPUNIT_TEST(ruleCache);
+    CPPUNIT_TEST(parallelExtraction);
+    CPPUNIT_TEST(incremental);
+    CPPUNIT_TEST(manifest);
+    CPPUNIT_TEST(unity);
+    CPPUNIT_TEST(precompiledHeaders);
+    CPPUNIT_TEST(programs);
+    CPPUNIT_TEST(profiles);
+#ifndef _WIN32
+    CPPUNIT_TEST(directBuild);
+    CPPUNIT_TEST(buildPool);
+    CPPUNIT_TEST(objectCache);
+#endif
     CPPUNIT_TEST_SUITE_END();
 public:
+    void setUp() {
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+    }
+
+    void tearDown() {
+        fs::remove_all(dir);
+    }
+
     void sourceFilename() {
         AutoProject ap;
         CPPUNIT_ASSERT(!ap.createProject(false));
     }
 
+    void missingTemplate() {
+        auto config{configuration("{extras}\n")};
+        config.srclevelcmakefilename = dir / "missing.txt";
+        const std::map<std::string, LangConfig> lang{ { "c++", config } };
+        std::ofstream{dir / "lost.md"}
+            << "### tags: ['c++']\n\n"
+            << "    int main() {}\n";
+        AutoProject ap{dir / "lost.md", lang};
+        // a daemon must be able to report this and carry on
+        bool threw{false};
+        try {
+            ap.createProject(true);
+        }
+        catch (std::runtime_error& e) {
+            threw = std::string{e.what()}.find("missing.txt") != std::string::npos;
+        }
+        CPPUNIT_ASSERT(threw);
+    }
+
+    void headerRules() {
+        const std::string rules{"<thread>@find_package(Threads)@threads@-pthread\n<png.h>@find_package(PNG)@png@-I/opt/png -lpng\n\\s*#include\\s*\"zlib.h\"@@z\n"};
+        std::ofstream{dir / "headers.md"}
+            << "### tags: ['c++']\n\n"
+            << "    #include <thread>\n"
+            << "    #  include\t<png.h> // comment\n"
+            << "    // #include <vector>\n"
+            << "    #include \"zlib.h\"\n";
+        const std::map<std::string, LangConfig> lang{ { "c++", configuration("{extras}\nlibs:{libraries}\n", rules) } };
+        AutoProject ap{dir / "headers.md", lang};
+        CPPUNIT_ASSERT(ap.createProject(true));
+        const auto text{read(dir / "headers" / "src" / "CMakeLists.txt")};
+        CPPUNIT_ASSERT(text.find("find_package(Threads)") != std::string::npos);
+        CPPUNIT_ASSERT(text.find("find_package(PNG)") != std::string::npos);
+        CPPUNIT_ASSERT(text.find(" z") != std::string::npos);
+        // with no Compiler configured, the compilation database names the usual one, with the rules' compile flags
+        const auto database{read(dir / "headers" / "compile_commands.json")};
+        CPPUNIT_ASSERT(database.find("c++\",\"-pthread\",\"-I/opt/png\",\"-c\",\"src/main.cpp\"") != std::string::npos);
+        CPPUNIT_ASSERT(database.find("-lpng") == std::string::npos);
+    }
+
+    void ruleCache() {
+        const std::string rules{"<thread>@find_package(Threads)\\nset(X 1)@threads\n\\s*#include\\s*\"zlib.h\"@@z\n"};
+        auto config{configuration("{extras}\nlibs:{libraries}\n", rules)};
+        config.cachedir = dir / "cache";
+        std::ofstream{dir / "first.txt"} << rules;
+        std::ofstream{dir / "second.txt"} << rules;
+        std::ofstream{dir / "cached.md"}
+            << "### tags: ['c++']\n\n"
+            << "    #include <thread>\n"
+            << "    #include \"zlib.h\"\n";
+        std::string output[2];
+        for (unsigned i{0}; i < 2; ++i) {
+            // a different rules file with the same contents hits the same cache entry
+            config.rulesfilename = dir / (i ? "second.txt" : "first.txt");
+            const std::map<std::string, LangConfig> lang{ { "c++", config } };
+            std::stringstream log;
+            auto saved{std::cout.rdbuf(log.rdbuf())};
+            AutoProject ap{dir / "cached.md", lang};
+            const bool created{ap.createProject(true)};
+            std::cout.rdbuf(saved);
+            CPPUNIT_ASSERT(created);
+            CPPUNIT_ASSERT((log.str().find("from cache") != std::string::npos) == (i == 1));
+            output[i] = read(dir / "cached" / "src" / "CMakeLists.txt");
+        }
+        CPPUNIT_ASSERT(output[0] == output[1]);
+        CPPUNIT_ASSERT(output[1].find("find_package(Threads)\nset(X 1)") != std::string::npos);
+        CPPUNIT_ASSERT(output[1].find(" z") != std::string::npos);
+    }
+
+    void parallelExtraction() {
+        auto cpp{configuration("{extras}\nlibs:{libraries}\n", "<thread>@find_package(Threads)@threads\n<png.h>@find_package(PNG)@png\n")};
+        cpp.rulesfilename = dir / "cpp.txt";
+        fs::rename(dir / "rules.txt", cpp.rulesfilename);
+        auto c{configuration("{extras}\nlibs:{libraries}\n", "<pthread.h>@find_package(Threads)@threads\n\\s*#include\\s*\"zlib.h\"@@z\n")};
+        c.rulesfilename = dir / "c.txt";
+        fs::rename(dir / "rules.txt", c.rulesfilename);
+        const std::map<std::string, LangConfig> lang{ { "c++", cpp }, { "c", c } };
+        static constexpr unsigned files{64};
+        static constexpr std::string_view includes[]{
+            "#include <thread>", "#include <png.h>", "#include <pthread.h>", "#include \"zlib.h\"", "#include <vector>",
+        };
+        for (unsigned i{0}; i < files; ++i) {
+            std::ofstream md{dir / ("p" + std::to_string(i) + ".md")};
+            md << "### tags: ['" << (i % 2 ? "c" : "c++") << "']\n\n";
+            for (unsigned j{0}; j < 5; ++j) {
+                if ((i >> j) & 1) {
+                    md << "    " << includes[j] << '\n';
+                }
+            }
+            md << "    int main() { return " << i << "; }\n";
+        }
+        // every extraction on its own first, then all of them at once, several times over
+        auto extract = [&](unsigned i) {
+            AutoProject ap{dir / ("p" + std::to_string(i) + ".md"), lang};
+            ap.createProject(true);
+            return read(dir / ("p" + std::to_string(i)) / "src" / "CMakeLists.txt");
+        };
+        std::stringstream log;
+        auto saved{std::cout.rdbuf(log.rdbuf())};
+        std::vector<std::string> expected;
+        for (unsigned i{0}; i < files; ++i) {
+            expected.push_back(extract(i));
+        }
+        std::vector<std::string> actual(files * 4);
+        std::vector<std::thread> threads;
+        for (unsigned t{0}; t < 8; ++t) {
+            threads.emplace_back([&, t]{
+                for (unsigned n{t}; n < actual.size(); n += 8) {
+                    actual[n] = extract(n % files);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        std::cout.rdbuf(saved);
+        for (unsigned n{0}; n < actual.size(); ++n) {
+            CPPUNIT_ASSERT(actual[n] == expected[n % files]);
+        }
+        // the c rules know nothing of <thread> but do know <pthread.h>
+        CPPUNIT_ASSERT(expected[1].find("find_package(Threads)") == std::string::npos);
+        CPPUNIT_ASSERT(expected[2].find("find_package(PNG)") != std::string::npos);
+        CPPUNIT_ASSERT(expected[5].find("find_package(Threads)") != std::string::npos);
+        CPPUNIT_ASSERT(expected[9].find(" z") != std::string::npos);
+    }
+
+    void incremental() {
+        fs::create_directories(dir / "clone" / "sub");
+        auto config{configuration("{extras}\nadd_executable({projname} {srcnames})\n")};
+        config.clonedir = "clone";
+        std::ofstream{dir / "clone" / "sub" / "notes.txt"} << "cloned\n";
+        std::ofstream{dir / "inc.md"}
+            << "### tags: ['c++']\n\n"
+            << "    #include <thread>\n"
+            << "    int main() {}\n\n"
+            << "util.h\n\n"
+            << "    int util();\n";
+        const std::map<std::string, LangConfig> lang{ { "c++", config } };
+        auto extract = [&](bool overwrite, bool incremental) {
+            AutoProject ap{dir / "inc.md", lang};
+            CPPUNIT_ASSERT(ap.createProject(overwrite, incremental));
+            return ap.unchangedFiles();
+        };
+        // main.cpp, util.h, the md copy, two CMakeLists.txt, the compilation database and the cloned file
+        static constexpr std::size_t outputs{7};
+        CPPUNIT_ASSERT(extract(false, true) == 0);
+        const auto mainfile{dir / "inc" / "src" / "main.cpp"};
+        const auto before{fs::last_write_time(mainfile)};
+        CPPUNIT_ASSERT(extract(false, true) == outputs);
+        CPPUNIT_ASSERT(fs::last_write_time(mainfile) == before);
+        std::ofstream{mainfile, std::ios::app} << "// edited\n";
+        CPPUNIT_ASSERT(extract(false, true) == outputs - 1);
+        CPPUNIT_ASSERT(read(mainfile) == "#include <thread>\nint main() {}\n\n");
+        // without the manifest, a forced overwrite rewrites everything
+        fs::remove(dir / "inc" / "autoproject.manifest");
+        CPPUNIT_ASSERT(extract(true, false) == 0);
+    }
+
+    void manifest() {
+        std::map<std::string, LangConfig> lang{ { "c++", configuration("{extras}\nadd_executable({projname} {srcnames})\n") } };
+        std::ofstream{dir / "memo.md"}
+            << "### tags: ['c++']\n\n"
+            << "    #include <thread>\n"
+            << "    int main() {}\n\n"
+            << "util.h\n\n"
+            << "    int util();\n";
+        auto extract = [&](bool overwrite = false){
+            AutoProject ap{dir / "memo.md", lang};
+            CPPUNIT_ASSERT(ap.createProject(overwrite, !overwrite));
+            return ap;
+        };
+        CPPUNIT_ASSERT(!extract().upToDate());
+        const auto again{extract()};
+        CPPUNIT_ASSERT(again.upToDate());
+        CPPUNIT_ASSERT((again.sourceFiles() == std::vector<fs::path>{"main.cpp", "util.h"}));
+        // a change to any input makes the project stale
+        std::ofstream{dir / "src.txt", std::ios::app} << "# more\n";
+        CPPUNIT_ASSERT(!extract().upToDate());
+        CPPUNIT_ASSERT(extract().upToDate());
+        // as does losing an output file
+        const auto util{dir / "memo" / "src" / "util.h"};
+        fs::remove(util);
+        CPPUNIT_ASSERT(!extract().upToDate());
+        CPPUNIT_ASSERT(fs::exists(util));
+        // or editing one without changing its size
+        std::ofstream{util} << "INT util();\n";
+        CPPUNIT_ASSERT(!extract().upToDate());
+        CPPUNIT_ASSERT(read(util) == "int util();\n");
+        // and a forced overwrite always writes the project again
+        CPPUNIT_ASSERT(extract().upToDate());
+        CPPUNIT_ASSERT(!extract(true).upToDate());
+        std::ofstream{dir / "memo.md", std::ios::app} << "\nMore prose.\n";
+        CPPUNIT_ASSERT(!extract().upToDate());
+        // a different configuration may pick different inputs
+        lang["c"] = lang["c++"];
+        CPPUNIT_ASSERT(!extract().upToDate());
+    }
+
+    void unity() {
+        auto config{configuration("{extras}add_executable({projname} {srcnames})\n")};
+        std::ofstream{dir / "jumbo.md"}
+            << "### tags: ['c++']\n\n"
+            << "    #include \"a.h\"\n"
+            << "    int main() { return a() + b(); }\n\n"
+            << "a.h\n\n"
+            << "    #define A_H\n"
+            << "    int a();\n"
+            << "    int b();\n\n"
+            << "a.cpp\n\n"
+            << "    int a() { return 0; }\n\n"
+            << "b.cpp\n\n"
+            << "    static int helper() { return 0; }\n"
+            << "    int b() { return helper(); }\n";
+        auto cmakeFile = [&]{
+            AutoProject ap{dir / "jumbo.md", { { "c++", config } }};
+            CPPUNIT_ASSERT(ap.createProject(true));
+            return read(dir / "jumbo" / "src" / "CMakeLists.txt");
+        };
+        CPPUNIT_ASSERT(cmakeFile().find("UNITY") == std::string::npos);
+        config.unity = true;
+        // the header's macro is harmless, but b.cpp's static function could clash
+        CPPUNIT_ASSERT(cmakeFile() == "set(CMAKE_UNITY_BUILD ON)\n"
+            "set_source_files_properties(\"b.cpp\" PROPERTIES SKIP_UNITY_BUILD_INCLUSION ON)\n"
+            "add_executable(jumbo  \"main.cpp\" \"a.h\" \"a.cpp\" \"b.cpp\")\n");
+        std::ofstream{dir / "jumbo.md", std::ios::app}
+            << "\nc.cpp\n\n"
+            << "    struct Point { int x; };\n"
+            << "    int c() { return Point{0}.x; }\n\n"
+            << "d.cpp\n\n"
+            << "    struct stat;\n"
+            << "    struct Point\n"
+            << "    {\n"
+            << "        double y;\n"
+            << "    };\n\n"
+            << "e.cpp\n\n"
+            << "    const int limit{3};\n\n"
+            << "f.cpp\n\n"
+            << "    constexpr int square(int x) { return x * x; }\n"
+            << "    struct stat info;\n\n"
+            << "g.cpp\n\n"
+            << "    namespace{ int h; }\n";
+        // both definitions of Point, the const variable and the unnamed namespace would clash, but not the constexpr function
+        const std::string skipped{"set_source_files_properties(\"b.cpp\" \"c.cpp\" \"d.cpp\" \"e.cpp\" \"g.cpp\" PROPERTIES SKIP_UNITY_BUILD_INCLUSION ON)\n"};
+        CPPUNIT_ASSERT(cmakeFile().find(skipped) != std::string::npos);
+        // and any source can be left out by name
+        config.unityskip = "a.cpp missing.cpp";
+        CPPUNIT_ASSERT(cmakeFile().find("set_source_files_properties(\"a.cpp\" \"b.cpp\" \"c.cpp\"") != std::string::npos);
+    }
+
+    void precompiledHeaders() {
+        auto config{configuration("add_executable({projname} {srcnames})\n{precompiled}")};
+        std::ofstream md{dir / "pch.md"};
+        md << "### tags: ['c++']\n\n"
+            << "    #include <string>\n"
+            << "    #include <vector>\n"
+            << "    #include \"util.h\"\n"
+            << "    int main() {}\n\n"
+            << "util.h\n\n"
+            << "    #include <map>\n"
+            << "    #include <string>\n\n"
+            << "a.cpp\n\n"
+            << "    #include <vector>\n"
+            << "    # include <string>\n"
+            << "    #include <map>\n\n";
+        md.flush();
+        auto cmakeFile = [&]{
+            AutoProject ap{dir / "pch.md", { { "c++", config } }};
+            CPPUNIT_ASSERT(ap.createProject(true));
+            return read(dir / "pch" / "src" / "CMakeLists.txt");
+        };
+        // too few sources to be worth it
+        CPPUNIT_ASSERT(cmakeFile().find("precompile") == std::string::npos);
+        md << "b.cpp\n\n"
+            << "    #define _USE_MATH_DEFINES\n"
+            << "    #include <cmath>\n"
+            << "    #ifdef _WIN32\n"
+            << "    #include <windows.h>\n"
+            << "    #endif\n"
+            << "    #include <string>\n";
+        md.close();
+        // only headers shared by two sources, never conditional ones, and b.cpp's macro must come first
+        CPPUNIT_ASSERT(cmakeFile() == "add_executable(pch  \"main.cpp\" \"util.h\" \"a.cpp\" \"b.cpp\")\n"
+            "target_precompile_headers(pch PRIVATE <string> <vector>)\n"
+            "set_source_files_properties(\"b.cpp\" PROPERTIES SKIP_PRECOMPILE_HEADERS ON)\n\n");
+    }
+
+    void programs() {
+        auto config{configuration("add_executable({projname} {srcnames})\n{programs}")};
+        std::ofstream{dir / "two.md"}
+            << "### tags: ['c++']\n\n"
+            << "list.h\n\n"
+            << "    int sum(int n);\n\n"
+            << "list.cpp\n\n"
+            << "    #include \"list.h\"\n"
+            << "    int sum(int n) { return n; }\n\n"
+            << "main.cpp\n\n"
+            << "    #include \"list.h\"\n"
+            << "    int main() { return sum(0); }\n\n"
+            << "test.cpp\n\n"
+            << "    #include \"../list.h\"\n"
+            << "    #include \"check.h\"\n"
+            << "    int main(int argc, char *argv[]) { return check(sum(argc)); }\n\n"
+            << "check.h\n\n"
+            << "    int check(int n);\n\n"
+            << "check.cpp\n\n"
+            << "    int check(int n) { return n; }\n\n"
+            << "extra.cpp\n\n"
+            << "    int unused() { return 0; }\n";
+        config.compiler = "c++";
+        config.generator = Generator::make;
+        AutoProject ap{dir / "two.md", { { "c++", config } }};
+        CPPUNIT_ASSERT(ap.createProject(true));
+        const auto cmake{read(dir / "two" / "src" / "CMakeLists.txt")};
+        // list.cpp serves both programs and extra.cpp neither, so both are shared; check.cpp is the test's own
+        CPPUNIT_ASSERT(cmake == "add_executable(two  \"list.h\" \"main.cpp\" \"check.h\")\n"
+            "add_library(two_shared OBJECT \"list.cpp\" \"extra.cpp\")\n"
+            "target_link_libraries(two two_shared)\n"
+            "add_executable(two_test \"test.cpp\" \"check.cpp\")\n"
+            "target_link_libraries(two_test two_shared)\n"
+            "get_target_property(features two COMPILE_FEATURES)\n"
+            "if (features)\n"
+            "    foreach(target two_shared two_test)\n"
+            "        target_compile_features(${target} PRIVATE ${features})\n"
+            "    endforeach()\n"
+            "endif()\n\n");
+        // the build file builds the first program, but every source is in the compilation database
+        const auto makefile{read(dir / "two" / "Makefile")};
+        CPPUNIT_ASSERT(makefile.find("OBJECTS = build/list.cpp.o build/main.cpp.o build/extra.cpp.o\n") != std::string::npos);
+        const auto database{read(dir / "two" / "compile_commands.json")};
+        CPPUNIT_ASSERT(database.find("\"file\":\"src/check.cpp\"") != std::string::npos);
+    }
+
+    void profiles() {
+        auto config{configuration("{extras}add_executable({projname} {srcnames})\n")};
+        std::ofstream{dir / "fast.md"}
+            << "### tags: ['c++']\n\n"
+            << "    int main() {}\n";
+        config.compiler = "c++";
+        config.compileflags = "-std=c++17";
+        config.generator = Generator::make;
+        auto text = [&](const fs::path& filename){
+            return read(dir / "fast" / filename);
+        };
+        auto extract = [&](Profile profile){
+            config.profile = profile;
+            AutoProject ap{dir / "fast.md", { { "c++", config } }};
+            CPPUNIT_ASSERT(ap.createProject(true));
+        };
+        extract(Profile::none);
+        CPPUNIT_ASSERT(text("src/CMakeLists.txt").find("AUTOPROJECT_PROFILE") == std::string::npos);
+        CPPUNIT_ASSERT(text("Makefile").find("COMPILEFLAGS = -std=c++17\n") != std::string::npos);
+        extract(Profile::release);
+        CPPUNIT_ASSERT(fs::is_directory(dir / "fast" / "build-release"));
+        CPPUNIT_ASSERT(text("src/CMakeLists.txt").find("set(AUTOPROJECT_PROFILE release CACHE STRING") == 0);
+        CPPUNIT_ASSERT(text("Makefile").find("COMPILEFLAGS = -std=c++17 -O2 -DNDEBUG\n") != std::string::npos);
+        CPPUNIT_ASSERT(text("Makefile").find("build-release/main.cpp.o: src/main.cpp\n") != std::string::npos);
+        CPPUNIT_ASSERT(text("src/CMakeLists.txt").find("add_compile_options(-fprofile-use=${AUTOPROJECT_PGO_DIR} -Wno-missing-profile)\n") != std::string::npos);
+        // a build directory configured with the profile none, as --matrix does, gets no flags from it
+        CPPUNIT_ASSERT(text("src/CMakeLists.txt").find("if (AUTOPROJECT_PROFILE STREQUAL \"none\")\n    #") != std::string::npos);
+        // an up to date project still knows its language, and so its build directory
+        {
+            AutoProject ap{dir / "fast.md", { { "c++", config } }};
+            CPPUNIT_ASSERT(ap.createProject(false) && ap.upToDate());
+            CPPUNIT_ASSERT(ap.language() == "c++" && ap.buildDir() == "build-release");
+        }
+        extract(Profile::lto);
+        CPPUNIT_ASSERT(text("Makefile").find("LINKFLAGS = -flto\n") != std::string::npos);
+    }
+
+    void directBuild() {
+        auto config{configuration("add_executable({projname} {srcnames})\n", "<thread>@find_package(Threads)@threads@-pthread\n")};
+        std::ofstream{dir / "direct.md"}
+            << "### tags: ['c++']\n\n"
+            << "    #include <iostream>\n"
+            << "    #include <thread>\n"
+            << "    #include \"util.h\"\n"
+            << "    int main() { std::thread t{[]{ std::cout << util() << '\\n'; }}; t.join(); }\n\n"
+            << "util.h\n\n"
+            << "    inline int util() { return 42; }\n\n"
+            << "maths.cpp\n\n"
+            << "    #define _USE_MATH_DEFINES\n"
+            << "    #include <cmath>\n"
+            << "    double pi() { return M_PI; }\n";
+        config.generator = Generator::make;
+        config.compiler = "c++";
+        config.compileflags = "-std=c++17";
+        config.sharedheaders = "<iostream> <string>";
+        config.cachedir = dir / "cache";
+        AutoProject ap{dir / "direct.md", { { "c++", config } }};
+        CPPUNIT_ASSERT(ap.createProject(true));
+        const auto text{read(dir / "direct" / "Makefile")};
+        CPPUNIT_ASSERT(text.find("LINKFLAGS = -pthread\n") != std::string::npos);
+        CPPUNIT_ASSERT(text.find("-include \"" + (dir / "cache").string()) != std::string::npos);
+        CPPUNIT_ASSERT(text.find("OBJECTS = build/main.cpp.o build/maths.cpp.o\n") != std::string::npos);
+        // maths.cpp's macro must come before any system header, so it does without the shared one
+        CPPUNIT_ASSERT(text.find("build/maths.cpp.o: COMPILEFLAGS = -std=c++17 -pthread\n") != std::string::npos);
+        CPPUNIT_ASSERT(text.find("build/main.cpp.o: COMPILEFLAGS") == std::string::npos);
+        // the preset configures with the initial cache, when CMake can make one
+        if (std::system("cmake --version > /dev/null 2>&1") == 0) {
+            const auto presets{read(dir / "direct" / "CMakePresets.json")};
+            CPPUNIT_ASSERT(presets.find("\"binaryDir\": \"${sourceDir}/build\"") != std::string::npos);
+            CPPUNIT_ASSERT(presets.find("\"CMAKE_PROJECT_INCLUDE_BEFORE\": \"" + (dir / "cache").generic_string() + "/cmake-") != std::string::npos);
+            // unless the probe is turned off
+            auto plain{config};
+            plain.initialcache = false;
+            fs::copy_file(dir / "direct.md", dir / "plain.md");
+            AutoProject without{dir / "plain.md", { { "c++", plain } }};
+            CPPUNIT_ASSERT(without.createProject(true));
+            CPPUNIT_ASSERT(!fs::exists(dir / "plain" / "CMakePresets.json"));
+        }
+        // from md to running program with no configure step
+        if (std::system("make --version > /dev/null 2>&1") == 0) {
+            const auto output{dir / "output.txt"};
+            const auto command{"make -s -C \"" + (dir / "direct").string() + "\" run > \"" + output.string() + "\""};
+            CPPUNIT_ASSERT(std::system(command.c_str()) == 0);
+            const auto result{read(output)};
+            CPPUNIT_ASSERT(result == "42\n");
+        }
+    }
+
+    void buildPool() {
+        if (std::system("cmake --version > /dev/null 2>&1") != 0) {
+            return;
+        }
+        auto config{configuration("{extras}add_executable({projname} {srcnames})\n", "<thread>@find_package(Threads)@threads\n", "cmake_minimum_required(VERSION 3.16)\nproject({projname})\nadd_subdirectory(src)\n")};
+        for (const auto name : { "first", "second" }) {
+            std::ofstream{dir / (std::string{name} + ".md")}
+                << "### tags: ['c++']\n\n"
+                << "    #include <thread>\n"
+                << "    int main() { std::thread t{[]{}}; t.join(); }\n";
+        }
+        config.cachedir = dir / "cache";
+        config.profile = Profile::release;
+        config.buildpool = 1;
+        std::stringstream status;
+        {
+            AutoProject ap{dir / "first.md", { { "c++", config } }};
+            CPPUNIT_ASSERT(ap.createProject(false));
+            status << ap;
+        }
+        // there was nothing in the pool for the first, but it is filled in the background for the next
+        CPPUNIT_ASSERT(!fs::exists(dir / "first" / "build-release" / "CMakeCache.txt"));
+        CPPUNIT_ASSERT(status.str().find("ahead of time") == std::string::npos);
+        CPPUNIT_ASSERT(waitForPool(dir / "cache"));
+        status.str({});
+        {
+            AutoProject ap{dir / "second.md", { { "c++", config } }};
+            CPPUNIT_ASSERT(ap.createProject(false));
+            status << ap;
+        }
+        CPPUNIT_ASSERT(fs::exists(dir / "second" / "build-release" / "CMakeCache.txt"));
+        CPPUNIT_ASSERT(status.str().find("The build directory was configured ahead of time\n") != std::string::npos);
+        const auto command{"cmake -S \"" + (dir / "second").string() + "\" -B \"" + (dir / "second" / "build-release").string()
+            + "\" > /dev/null 2>&1 && cmake --build \"" + (dir / "second" / "build-release").string() + "\" > /dev/null 2>&1"};
+        CPPUNIT_ASSERT(std::system(command.c_str()) == 0);
+        // the second project took the only tree, so wait for its replacement before cleaning up
+        CPPUNIT_ASSERT(waitForPool(dir / "cache"));
+    }
+
+    void objectCache() {
+        if (std::system("c++ --version > /dev/null 2>&1") != 0) {
+            return;
+        }
+        auto config{configuration("add_executable({projname} {srcnames})\n", "")};
+        std::ofstream{dir / "cached.md"} << "### tags: ['c++']\n\n    int main() {}\n";
+        config.generator = Generator::make;
+        config.compiler = "c++";
+        config.cachedir = dir / "cache";
+        config.objectcache = "/opt/bin/autoproject";
+        AutoProject ap{dir / "cached.md", { { "c++", config } }};
+        CPPUNIT_ASSERT(ap.createProject(true));
+        const auto cachedir{fs::absolute(dir / "cache").lexically_normal()};
+        const auto makefile{read(dir / "cached" / "Makefile")};
+        CPPUNIT_ASSERT(makefile.find("LAUNCHER = \"/opt/bin/autoproject\" \"--object-cache\" \"" + cachedir.string() + "\"\n") != std::string::npos);
+        // and so do CMake builds configured with the preset
+        const auto presets{read(dir / "cached" / "CMakePresets.json")};
+        CPPUNIT_ASSERT(presets.find("\"CMAKE_CXX_COMPILER_LAUNCHER\": \"/opt/bin/autoproject;--object-cache;" + cachedir.generic_string() + "\"") != std::string::npos);
+    }
+
 private:
+    /*! write the rules and the top and source level templates into `dir`
+     * and return a configuration that uses them.
+     */
+    LangConfig configuration(const std::string& srcTemplate, const std::string& rules = "<thread>@find_package(Threads)@threads\n",
+            const std::string& topTemplate = "project({projname})\n") const {
+        std::ofstream{dir / "rules.txt"} << rules;
+        std::ofstream{dir / "top.txt"} << topTemplate;
+        std::ofstream{dir / "src.txt"} << srcTemplate;
+        LangConfig config;
+        config.configdir = dir;
+        config.rulesfilename = dir / "rules.txt";
+        config.toplevelcmakefilename = dir / "top.txt";
+        config.srclevelcmakefilename = dir / "src.txt";
+        return config;
+    }
+
+    // the contents of `filename`
+    static std::string read(const fs::path& filename) {
+        std::stringstream text;
+        text << std::ifstream{filename}.rdbuf();
+        return text.str();
+    }
+
+    // wait until nothing in the pools of `cachedir` is being configured, and say whether any tree is ready
+    static bool waitForPool(const fs::path& cachedir) {
+        for (int tries{0}; tries < 600; ++tries) {
+            bool filling{false};
+            bool ready{false};
+            for (const auto& pool : fs::directory_iterator(cachedir)) {
+                if (pool.path().filename().string().rfind("pool-", 0) != 0) {
+                    continue;
+                }
+                for (const auto& entry : fs::directory_iterator(pool.path())) {
+                    const auto name{entry.path().filename().string()};
+                    filling = filling || name.rfind("fill-", 0) == 0;
+                    ready = ready || name.rfind("ready-", 0) == 0;
+                }
+            }
+            if (!filling) {
+                return ready;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds{100});
+        }
+        return false;
+    }
+
+    const fs::path dir{fs::temp_directory_path() / "AutoProjectTest"};
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(AutoProjectTest);
@@ -0,0 +1,147 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <sstream>
+#include <stdexcept>
+#include <cppunit/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include "BuildFile.h"
+
+class BuildFileTest : public CppUnit::TestFixture {
+    CPPUNIT_TEST_SUITE(BuildFileTest);
+    CPPUNIT_TEST(ninja);
+    CPPUNIT_TEST(ninjaEscapes);
+    CPPUNIT_TEST(make);
+    CPPUNIT_TEST(assembler);
+    CPPUNIT_TEST(ruleFlags);
+    CPPUNIT_TEST(compilationDatabase);
+    CPPUNIT_TEST(sharedHeader);
+    CPPUNIT_TEST(launcher);
+    CPPUNIT_TEST_SUITE_END();
+public:
+    void ninja() {
+        const auto text{ninjaFile(spec())};
+        CPPUNIT_ASSERT(contains(text, "compiler = /usr/bin/c++\n"));
+        CPPUNIT_ASSERT(contains(text, "compileflags = -std=c++17\n"));
+        CPPUNIT_ASSERT(contains(text, "linkflags = -pthread\n"));
+        CPPUNIT_ASSERT(contains(text, "  deps = gcc\n"));
+        CPPUNIT_ASSERT(contains(text, "build build/main.cpp.o: compile src/main.cpp\n"));
+        CPPUNIT_ASSERT(contains(text, "build build/util.c.o: compile src/util.c\n"));
+        CPPUNIT_ASSERT(contains(text, "build build/demo: link build/main.cpp.o build/util.c.o\n"));
+        CPPUNIT_ASSERT(contains(text, "default build/demo\n"));
+        CPPUNIT_ASSERT(contains(text, "# compiler: c++ 12.2.0\n"));
+    }
+
+    void ninjaEscapes() {
+        auto odd{spec()};
+        odd.target = "a b";
+        odd.sources = {"src/x:y.cpp"};
+        odd.linkFlags = "-L$HOME";
+        const auto text{ninjaFile(odd)};
+        CPPUNIT_ASSERT(contains(text, "build build/x$:y.cpp.o: compile src/x$:y.cpp\n"));
+        CPPUNIT_ASSERT(contains(text, "build build/a$ b: link build/x$:y.cpp.o\n"));
+        CPPUNIT_ASSERT(contains(text, "linkflags = -L$$HOME\n"));
+    }
+
+    void make() {
+        const auto text{makeFile(spec())};
+        CPPUNIT_ASSERT(contains(text, "COMPILER = /usr/bin/c++\n"));
+        CPPUNIT_ASSERT(contains(text, "OBJECTS = build/main.cpp.o build/util.c.o\n"));
+        CPPUNIT_ASSERT(contains(text, "build/demo: $(OBJECTS)\n\t$(LINKER) $(OBJECTS) -o $@ $(LINKFLAGS)\n"));
+        CPPUNIT_ASSERT(contains(text, "build/main.cpp.o: src/main.cpp\n\t$(COMPILER) $(COMPILEFLAGS) -MMD -MP -MF $@.d -c $< -o $@\n"));
+        CPPUNIT_ASSERT(contains(text, "-include $(OBJECTS:=.d)\n"));
+        CPPUNIT_ASSERT(contains(text, "run: build/demo\n\t./build/demo\n"));
+        auto profiled{spec()};
+        profiled.buildDir = "build-native";
+        const auto native{makeFile(profiled)};
+        CPPUNIT_ASSERT(contains(native, "OBJECTS = build-native/main.cpp.o build-native/util.c.o\n"));
+        CPPUNIT_ASSERT(contains(native, "run: build-native/demo\n\t./build-native/demo\n"));
+    }
+
+    void assembler() {
+        BuildSpec asmSpec{"hello", {"src/main.asm"}, "/usr/bin/nasm", {}, "-f elf64", "/usr/bin/ld", {}, false};
+        const auto ninja{ninjaFile(asmSpec)};
+        CPPUNIT_ASSERT(contains(ninja, "  command = $compiler $compileflags $in -o $out\n"));
+        CPPUNIT_ASSERT(!contains(ninja, "depfile"));
+        CPPUNIT_ASSERT(!contains(ninja, "# compiler:"));
+        const auto make{makeFile(asmSpec)};
+        CPPUNIT_ASSERT(contains(make, "\t$(COMPILER) $(COMPILEFLAGS) $< -o $@\n"));
+        CPPUNIT_ASSERT(!contains(make, "-include"));
+    }
+
+    void ruleFlags() {
+        BuildSpec flagged;
+        addRuleFlags(flagged, "-pthread -lpng -L /opt/lib -I/opt/include -isystem /opt/sys -framework Cocoa");
+        CPPUNIT_ASSERT(flagged.compileFlags == "-pthread -I/opt/include -isystem /opt/sys");
+        CPPUNIT_ASSERT(flagged.linkFlags == "-pthread -lpng -L /opt/lib -framework Cocoa");
+        addRuleFlags(flagged, "-DUSE_PNG");
+        CPPUNIT_ASSERT(flagged.compileFlags == "-pthread -I/opt/include -isystem /opt/sys -DUSE_PNG");
+    }
+
+    void compilationDatabase() {
+        auto linked{spec()};
+        linked.linkFlags.clear();
+        addRuleFlags(linked, "-pthread -lpng -L/opt/lib -I/opt/include");
+        const auto text{::compilationDatabase(linked, "/home/me/demo")};
+        CPPUNIT_ASSERT(text.front() == '[');
+        CPPUNIT_ASSERT(contains(text, "\"directory\":\"/home/me/demo\""));
+        CPPUNIT_ASSERT(contains(text, "\"arguments\":[\"/usr/bin/c++\",\"-std=c++17\",\"-pthread\",\"-I/opt/include\",\"-c\",\"src/main.cpp\",\"-o\",\"build/main.cpp.o\"]"));
+        CPPUNIT_ASSERT(contains(text, "\"file\":\"src/util.c\",\"output\":\"build/util.c.o\""));
+        CPPUNIT_ASSERT(!contains(text, "-lpng"));
+        CPPUNIT_ASSERT(!contains(text, "/opt/lib"));
+        CPPUNIT_ASSERT(contains(text, "},\n  {"));
+        CPPUNIT_ASSERT(contains(text, "}\n]\n"));
+    }
+
+    void sharedHeader() {
+        auto shared{spec()};
+        shared.sharedHeader = "/cache/pch-1/shared.hpp";
+        CPPUNIT_ASSERT(contains(ninjaFile(shared), "compileflags = -std=c++17 -include \"/cache/pch-1/shared.hpp\"\n"));
+        CPPUNIT_ASSERT(contains(makeFile(shared), "COMPILEFLAGS = -std=c++17 -include \"/cache/pch-1/shared.hpp\"\n"));
+        CPPUNIT_ASSERT(!contains(::compilationDatabase(shared, "/home/me/demo"), "shared.hpp"));
+        // a source that defines a macro ahead of its includes is compiled without it
+        shared.unshared = {"src/util.c"};
+        CPPUNIT_ASSERT(contains(ninjaFile(shared), "build build/util.c.o: compile src/util.c\n  compileflags = -std=c++17\n"));
+        CPPUNIT_ASSERT(!contains(ninjaFile(shared), "src/main.cpp\n  compileflags"));
+        CPPUNIT_ASSERT(contains(makeFile(shared), "build/util.c.o: COMPILEFLAGS = -std=c++17\nbuild/util.c.o: src/util.c\n"));
+        CPPUNIT_ASSERT(!contains(makeFile(shared), "build/main.cpp.o: COMPILEFLAGS"));
+    }
+
+    void launcher() {
+        auto launched{spec()};
+        launched.launcher = "\"/usr/bin/autoproject\" \"--object-cache\" \"/cache\"";
+        const auto ninja{ninjaFile(launched)};
+        CPPUNIT_ASSERT(contains(ninja, "launcher = \"/usr/bin/autoproject\" \"--object-cache\" \"/cache\"\n"));
+        CPPUNIT_ASSERT(contains(ninja, "  command = $launcher $compiler $compileflags -MD"));
+        CPPUNIT_ASSERT(contains(ninja, "  command = $linker $in"));
+        const auto make{makeFile(launched)};
+        CPPUNIT_ASSERT(contains(make, "\t$(LAUNCHER) $(COMPILER) $(COMPILEFLAGS) -MMD"));
+        CPPUNIT_ASSERT(contains(make, "\t$(LINKER) $(OBJECTS)"));
+        CPPUNIT_ASSERT(!contains(::compilationDatabase(launched, "/home/me/demo"), "object-cache"));
+        CPPUNIT_ASSERT(!contains(ninjaFile(spec()), "launcher"));
+        CPPUNIT_ASSERT(!contains(makeFile(spec()), "LAUNCHER"));
+    }
+
+private:
+    static BuildSpec spec() {
+        return {"demo", {"src/main.cpp", "src/util.c"}, "/usr/bin/c++", "c++ 12.2.0", "-std=c++17", "/usr/bin/c++", "-pthread"};
+    }
+
+    static bool contains(const std::string& text, const std::string& piece) {
+        return text.find(piece) != std::string::npos;
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(BuildFileTest);
+
+int main() {
+    CppUnit::TextUi::TestRunner runner;
+    CppUnit::TestFactoryRegistry &registry = CppUnit::TestFactoryRegistry::getRegistry();
+    runner.addTest( registry.makeTest() );
+    bool wasSuccessful = runner.run();
+    std::cout << "wasSuccessful = " << std::boolalpha << wasSuccessful << '\n';
+    return !wasSuccessful;
+}
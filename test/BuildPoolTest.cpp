@@ -0,0 +1,121 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <sstream>
+#include <thread>
+#include <cppunit/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include "BuildPool.h"
+#include "Tool.h"
+
+using namespace std::literals;
+
+class BuildPoolTest : public CppUnit::TestFixture {
+    CPPUNIT_TEST_SUITE(BuildPoolTest);
+    CPPUNIT_TEST(noPool);
+#ifndef _WIN32
+    CPPUNIT_TEST(takeAndRefill);
+#endif
+    CPPUNIT_TEST_SUITE_END();
+public:
+    void setUp() {
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+    }
+
+    void tearDown() {
+        fs::remove_all(dir);
+    }
+
+    void noPool() {
+        const BuildPool none{cmakelists, {}, 2};
+        CPPUNIT_ASSERT(none.dir.empty() && none.ready() == 0 && !none.take(dir / "build"));
+        const BuildPool empty{cmakelists, dir / "cache", 0};
+        empty.refill();
+        CPPUNIT_ASSERT(empty.dir.empty() && empty.ready() == 0);
+        CPPUNIT_ASSERT(fs::is_empty(dir));
+    }
+
+    void takeAndRefill() {
+        if (!Tool::shared("cmake") || !Tool::shared("c++") || !Tool::shared("cc")) {
+            return;
+        }
+        const BuildPool pool{cmakelists, dir / "cache", 2};
+        CPPUNIT_ASSERT(!pool.dir.empty());
+        const auto project{dir / "project"};
+        CPPUNIT_ASSERT(!pool.take(project / "build"));
+        pool.refill();
+        CPPUNIT_ASSERT(waitForTrees(pool, 2));
+        // the same template and toolchain share the pool
+        CPPUNIT_ASSERT(BuildPool(cmakelists, dir / "cache", 2).dir == pool.dir);
+        CPPUNIT_ASSERT(BuildPool(cmakelists + "# another\n", dir / "cache", 2).dir != pool.dir);
+
+        CPPUNIT_ASSERT(pool.take(project / "build"));
+        CPPUNIT_ASSERT(pool.ready() == 1);
+        const auto cache{read(project / "build" / "CMakeCache.txt")};
+        CPPUNIT_ASSERT(cache.find("CMAKE_CXX_COMPILER:") != std::string::npos);
+        CPPUNIT_ASSERT(cache.find(pool.dir.string()) == std::string::npos);
+        CPPUNIT_ASSERT(cache.find("autoproject_probe_") == std::string::npos);
+        // the project may be configured with another generator than the pool was
+        CPPUNIT_ASSERT(cache.find("CMAKE_GENERATOR") == std::string::npos);
+        CPPUNIT_ASSERT(cache.find("CMAKE_MAKE_PROGRAM") == std::string::npos);
+        // the first configure of the project does not identify the compilers again
+        fs::create_directories(project);
+        std::ofstream{project / "CMakeLists.txt"} << "cmake_minimum_required(VERSION 3.16)\nproject(warm)\n"
+            << "find_package(Threads REQUIRED)\nadd_executable(warm main.cpp)\ntarget_link_libraries(warm ${CMAKE_THREAD_LIBS_INIT})\n";
+        std::ofstream{project / "main.cpp"} << "#include <thread>\nint main() { std::thread t{[]{}}; t.join(); }\n";
+        const auto log{dir / "configure.log"};
+        const auto command{"cmake -S \"" + project.string() + "\" -B \"" + (project / "build").string() + "\" > \"" + log.string()
+            + "\" 2>&1 && cmake --build \"" + (project / "build").string() + "\" > /dev/null 2>&1"};
+        CPPUNIT_ASSERT(std::system(command.c_str()) == 0);
+        CPPUNIT_ASSERT(read(log).find("compiler identification") == std::string::npos);
+        CPPUNIT_ASSERT(read(project / "build" / "CMakeCache.txt").find("CMAKE_HOME_DIRECTORY:INTERNAL=" + project.string()) != std::string::npos);
+
+        pool.refill();
+        CPPUNIT_ASSERT(waitForTrees(pool, 2));
+        pool.refill();
+        CPPUNIT_ASSERT(pool.ready() == 2);
+    }
+
+private:
+    static std::string read(const fs::path& filename) {
+        std::stringstream text;
+        text << std::ifstream{filename}.rdbuf();
+        return text.str();
+    }
+
+    // wait until `pool` has `count` trees and none on the way
+    static bool waitForTrees(const BuildPool& pool, std::size_t count) {
+        for (int tries{0}; tries < 600; ++tries) {
+            bool filling{false};
+            for (const auto& entry : fs::directory_iterator(pool.dir)) {
+                filling = filling || entry.path().filename().string().rfind("fill-", 0) == 0;
+            }
+            if (!filling) {
+                return pool.ready() == count;
+            }
+            std::this_thread::sleep_for(100ms);
+        }
+        return false;
+    }
+
+    const fs::path dir{fs::temp_directory_path() / "BuildPoolTest"};
+    const std::string cmakelists{"cmake_minimum_required(VERSION 3.16)\nproject(autoproject_probe C CXX)\nfind_package(Threads QUIET)\n"};
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(BuildPoolTest);
+
+int main() {
+    CppUnit::TextUi::TestRunner runner;
+    CppUnit::TestFactoryRegistry &registry = CppUnit::TestFactoryRegistry::getRegistry();
+    runner.addTest( registry.makeTest() );
+    bool wasSuccessful = runner.run();
+    std::cout << "wasSuccessful = " << std::boolalpha << wasSuccessful << '\n';
+    return !wasSuccessful;
+}
@@ -0,0 +1,117 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <sstream>
+#include <cppunit/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include "InitialCache.h"
+#include "Tool.h"
+
+class InitialCacheTest : public CppUnit::TestFixture {
+    CPPUNIT_TEST_SUITE(InitialCacheTest);
+    CPPUNIT_TEST(nothingToMake);
+#ifndef _WIN32
+    CPPUNIT_TEST(probe);
+    CPPUNIT_TEST(failure);
+#endif
+    CPPUNIT_TEST_SUITE_END();
+public:
+    void setUp() {
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+    }
+
+    void tearDown() {
+        fs::remove_all(dir);
+    }
+
+    void nothingToMake() {
+        CPPUNIT_ASSERT(InitialCache("find_package(Threads)\n", {}).file.empty());
+        CPPUNIT_ASSERT(!InitialCache::shared("find_package(Threads)\n", {}));
+    }
+
+    void probe() {
+        if (!Tool::shared("cmake") || !Tool::shared("c++") || !Tool::shared("cc")) {
+            return;
+        }
+        const std::string packages{"find_package(Threads REQUIRED)\nfind_package(NoSuchPackageAnywhere REQUIRED)\n"};
+        const InitialCache made{packages, dir / "cache"};
+        CPPUNIT_ASSERT(fs::exists(made.file));
+        const auto text{read(made.file)};
+        CPPUNIT_ASSERT(text.find("set(CMAKE_CXX_COMPILER_FORCED TRUE CACHE INTERNAL \"\")\n") != std::string::npos);
+        CPPUNIT_ASSERT(text.find("set(CMAKE_CXX_COMPILER_ID ") != std::string::npos);
+        CPPUNIT_ASSERT(text.find("NoSuchPackageAnywhere") == std::string::npos);
+        CPPUNIT_ASSERT(text.find("NOTFOUND") == std::string::npos);
+        // once made, it is only found again
+        const auto time{fs::last_write_time(made.file)};
+        const InitialCache again{packages, dir / "cache"};
+        CPPUNIT_ASSERT(again.file == made.file && fs::last_write_time(again.file) == time);
+        // but other packages need a probe of their own
+        CPPUNIT_ASSERT(InitialCache("", dir / "cache").file.parent_path() != made.file.parent_path());
+        // and a project configured with it builds just the same
+        const auto project{dir / "project"};
+        fs::create_directories(project);
+        std::ofstream{project / "CMakeLists.txt"} << "cmake_minimum_required(VERSION 3.16)\nproject(seeded)\n"
+            << "find_package(Threads REQUIRED)\nadd_executable(seeded main.cpp)\ntarget_compile_features(seeded PUBLIC cxx_std_17)\n"
+            << "target_link_libraries(seeded ${CMAKE_THREAD_LIBS_INIT})\n";
+        std::ofstream{project / "main.cpp"} << "#include <thread>\nint main() { std::thread t{[]{}}; t.join(); }\n";
+        const auto command{"cmake -C \"" + made.file.string() + "\" -S \"" + project.string() + "\" -B \"" + (project / "build").string()
+            + "\" > /dev/null 2>&1 && cmake --build \"" + (project / "build").string() + "\" > /dev/null 2>&1"};
+        CPPUNIT_ASSERT(std::system(command.c_str()) == 0);
+    }
+
+    void failure() {
+        if (!Tool::shared("cmake") || !Tool::shared("c++") || !Tool::shared("cc")) {
+            return;
+        }
+        const std::string packages{"message(FATAL_ERROR \"no such luck\")\n"};
+        CPPUNIT_ASSERT(InitialCache(packages, dir / "cache").file.empty());
+        fs::path marker;
+        for (const auto& entry : fs::directory_iterator(dir / "cache")) {
+            if (fs::exists(entry.path() / "failed")) {
+                marker = entry.path() / "failed";
+            }
+        }
+        CPPUNIT_ASSERT(!marker.empty());
+        // CMake's reasons are kept
+        CPPUNIT_ASSERT(read(marker.parent_path() / "probe.log").find("no such luck") != std::string::npos);
+        // and the probe is not run again for a while
+        const auto time{fs::last_write_time(marker) - std::chrono::hours{1}};
+        fs::last_write_time(marker, time);
+        CPPUNIT_ASSERT(InitialCache(packages, dir / "cache").file.empty());
+        CPPUNIT_ASSERT(fs::last_write_time(marker) == time);
+        // unless asked to
+        CPPUNIT_ASSERT(InitialCache(packages, dir / "cache", true).file.empty());
+        CPPUNIT_ASSERT(fs::last_write_time(marker) > time);
+        // or once the failure is old enough to have been a passing one
+        fs::last_write_time(marker, time - std::chrono::hours{24});
+        CPPUNIT_ASSERT(InitialCache(packages, dir / "cache").file.empty());
+        CPPUNIT_ASSERT(fs::last_write_time(marker) > time);
+    }
+
+private:
+    static std::string read(const fs::path& filename) {
+        std::stringstream text;
+        text << std::ifstream{filename}.rdbuf();
+        return text.str();
+    }
+
+    const fs::path dir{fs::temp_directory_path() / "InitialCacheTest"};
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(InitialCacheTest);
+
+int main() {
+    CppUnit::TextUi::TestRunner runner;
+    CppUnit::TestFactoryRegistry &registry = CppUnit::TestFactoryRegistry::getRegistry();
+    runner.addTest( registry.makeTest() );
+    bool wasSuccessful = runner.run();
+    std::cout << "wasSuccessful = " << std::boolalpha << wasSuccessful << '\n';
+    return !wasSuccessful;
+}
@@ -0,0 +1,102 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <sstream>
+#include <stdexcept>
+#include <cppunit/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include "Json.h"
+
+class JsonTest : public CppUnit::TestFixture {
+    CPPUNIT_TEST_SUITE(JsonTest);
+    CPPUNIT_TEST(parseObject);
+    CPPUNIT_TEST(roundTrip);
+    CPPUNIT_TEST(escapes);
+    CPPUNIT_TEST(missingMember);
+    CPPUNIT_TEST(malformed);
+    CPPUNIT_TEST(deepNesting);
+    CPPUNIT_TEST_SUITE_END();
+public:
+    void parseObject() {
+        auto json{Json::parse(sample)};
+        CPPUNIT_ASSERT(json.type() == Json::Type::object);
+        CPPUNIT_ASSERT(json["question_id"].asNumber() == 248232);
+        CPPUNIT_ASSERT(json["question_id"].asString() == "248232");
+        CPPUNIT_ASSERT(json["title"].asString() == "Hello, world");
+        CPPUNIT_ASSERT(json["tags"].items().size() == 2);
+        CPPUNIT_ASSERT(json["tags"].items()[0].asString() == "c++");
+        CPPUNIT_ASSERT(json["answered"].asBool(true) == false);
+    }
+
+    void roundTrip() {
+        auto json{Json::parse(sample)};
+        auto again{Json::parse(json.dump())};
+        std::cout << "dump = " << json << '\n';
+        CPPUNIT_ASSERT(json.dump() == again.dump());
+    }
+
+    void escapes() {
+        auto json{Json::parse(R"({"s":"a\"b\\c\nd\u00e9\ud83d\ude00"})")};
+        CPPUNIT_ASSERT(json["s"].asString() == "a\"b\\c\nd\xc3\xa9\xf0\x9f\x98\x80");
+        Json out{Json::object()};
+        out.set("s", std::string{"tab\there\x01"});
+        CPPUNIT_ASSERT(out.dump() == R"({"s":"tab\there\u0001"})");
+    }
+
+    void missingMember() {
+        auto json{Json::parse(sample)};
+        CPPUNIT_ASSERT(!json.has("body"));
+        CPPUNIT_ASSERT(json["body"].isNull());
+        CPPUNIT_ASSERT(json["body"]["deeper"].isNull());
+    }
+
+    void malformed() {
+        for (const auto text : {"{", "{\"a\":}", "[1,2", "\"unterminated", "{} extra", "nope"}) {
+            bool threw{false};
+            try {
+                Json::parse(text);
+            }
+            catch (JsonError& e) {
+                std::cout << text << ": " << e.what() << '\n';
+                threw = true;
+            }
+            CPPUNIT_ASSERT(threw);
+        }
+    }
+
+    void deepNesting() {
+        const auto nested{std::string(100, '[') + std::string(100, ']')};
+        CPPUNIT_ASSERT(Json::parse(nested).items().size() == 1);
+        bool threw{false};
+        try {
+            Json::parse(std::string(1000000, '['));
+        }
+        catch (JsonError& e) {
+            threw = std::string{e.what()}.find("nested too deeply") != std::string::npos;
+        }
+        CPPUNIT_ASSERT(threw);
+    }
+
+private:
+    const std::string sample{R"({
+        "question_id": 248232,
+        "title": "Hello, world",
+        "tags": ["c++", "beginner"],
+        "answered": false,
+        "owner": null
+    })"};
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(JsonTest);
+
+int main() {
+    CppUnit::TextUi::TestRunner runner;
+    CppUnit::TestFactoryRegistry &registry = CppUnit::TestFactoryRegistry::getRegistry();
+    runner.addTest( registry.makeTest() );
+    bool wasSuccessful = runner.run();
+    std::cout << "wasSuccessful = " << std::boolalpha << wasSuccessful << '\n';
+    return !wasSuccessful;
+}
@@ -0,0 +1,102 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <cppunit/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include "MappedFile.h"
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+class MappedFileTest : public CppUnit::TestFixture {
+    CPPUNIT_TEST_SUITE(MappedFileTest);
+    CPPUNIT_TEST(contents);
+    CPPUNIT_TEST(empty);
+    CPPUNIT_TEST(missing);
+#ifndef _WIN32
+    CPPUNIT_TEST(pipe);
+#endif
+    CPPUNIT_TEST(move);
+    CPPUNIT_TEST_SUITE_END();
+public:
+    void setUp() {
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+    }
+
+    void tearDown() {
+        fs::remove_all(dir);
+    }
+
+    void contents() {
+        std::ofstream{dir / "text", std::ios::binary} << text;
+        const MappedFile file{dir / "text"};
+        CPPUNIT_ASSERT(file.view() == text);
+    }
+
+    void empty() {
+        std::ofstream{dir / "empty"};
+        const MappedFile file{dir / "empty"};
+        CPPUNIT_ASSERT(file.view().empty() && file.view().data() == nullptr);
+    }
+
+    void missing() {
+        bool threw{false};
+        try {
+            MappedFile{dir / "missing"};
+        }
+        catch (std::runtime_error& e) {
+            threw = std::string{e.what()}.find("missing") != std::string::npos;
+        }
+        CPPUNIT_ASSERT(threw);
+    }
+
+    // a pipe cannot be mapped, so it is read, and only once
+    void pipe() {
+        const auto fifo{dir / "fifo"};
+        CPPUNIT_ASSERT(mkfifo(fifo.c_str(), 0600) == 0);
+        std::thread writer{[&]{ std::ofstream{fifo, std::ios::binary} << text; }};
+        const MappedFile file{fifo};
+        writer.join();
+        CPPUNIT_ASSERT(file.view() == text);
+    }
+
+    void move() {
+        std::ofstream{dir / "text", std::ios::binary} << text;
+        MappedFile first{dir / "text"};
+        const auto data{first.view().data()};
+        // the view survives the move, since the contents themselves do not move
+        MappedFile second{std::move(first)};
+        CPPUNIT_ASSERT(second.view() == text && second.view().data() == data);
+        CPPUNIT_ASSERT(first.view().empty());
+        std::ofstream{dir / "other", std::ios::binary} << "other";
+        MappedFile third{dir / "other"};
+        third = std::move(second);
+        CPPUNIT_ASSERT(third.view() == text && third.view().data() == data);
+        CPPUNIT_ASSERT(second.view().empty());
+        third = MappedFile{};
+        CPPUNIT_ASSERT(third.view().empty());
+    }
+
+private:
+    const fs::path dir{fs::temp_directory_path() / "MappedFileTest"};
+    const std::string text{"#include <iostream>\nint main() {}\n"};
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(MappedFileTest);
+
+int main() {
+    CppUnit::TextUi::TestRunner runner;
+    CppUnit::TestFactoryRegistry &registry = CppUnit::TestFactoryRegistry::getRegistry();
+    runner.addTest( registry.makeTest() );
+    bool wasSuccessful = runner.run();
+    std::cout << "wasSuccessful = " << std::boolalpha << wasSuccessful << '\n';
+    return !wasSuccessful;
+}
@@ -0,0 +1,114 @@
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <cppunit/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include "NativeHost.h"
+
+class NativeHostTest : public CppUnit::TestFixture {
+    CPPUNIT_TEST_SUITE(NativeHostTest);
+    CPPUNIT_TEST(markdown);
+    CPPUNIT_TEST(roundTrip);
+    CPPUNIT_TEST(tooLong);
+    CPPUNIT_TEST_SUITE_END();
+public:
+    void setUp() {
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+#ifdef _WIN32
+        _putenv_s("AUTOPROJECT_DIR", dir.string().c_str());
+#else
+        setenv("AUTOPROJECT_DIR", dir.c_str(), 1);
+#endif
+    }
+
+    void tearDown() {
+        fs::remove_all(dir);
+    }
+
+    void markdown() {
+        const auto question{Json::parse(R"({"question_id": 42, "title": "Is &lt;a&gt; &amp; &quot;b&quot; &#233;&#x1F600; &bogus; &#0;?",)"
+            R"("tags": ["c++", "beginner"], "body_markdown": "Text\r\n\r\n    int main() {}\r\n"})")};
+        CPPUNIT_ASSERT_EQUAL(std::string{"# [Is <a> & \"b\" \xc3\xa9\xf0\x9f\x98\x80 &bogus; &#0;?](https://codereview.stackexchange.com/questions/42)\n"
+            "### tags: ['c++', 'beginner']\n\nText\n\n    int main() {}\n"}, questionMarkdown(question));
+    }
+
+    void roundTrip() {
+        std::stringstream in;
+        in << frame(R"({"question_id": 42, "title": "Hello", "tags": ["c++"], "body_markdown": "    int main() {}\r\n"})")
+            << frame(R"({"question_id": "../42", "title": "Escape", "tags": [], "body_markdown": ""})");
+        std::stringstream out;
+        CPPUNIT_ASSERT(runNativeHost(in, out, true, { { "c++", configuration() } }) == 0);
+        const auto replies{unframe(out.str())};
+        CPPUNIT_ASSERT(replies.size() == 2);
+        const auto first{Json::parse(replies[0])};
+        CPPUNIT_ASSERT(first["ok"].asBool() && first["question_id"].asString() == "42");
+        CPPUNIT_ASSERT(fs::exists(dir / "42" / "src" / "main.cpp"));
+        const auto second{Json::parse(replies[1])};
+        CPPUNIT_ASSERT(!second["ok"].asBool(true) && second["error"].asString().find("question_id") != std::string::npos);
+    }
+
+    void tooLong() {
+        // a length beyond any real message means the framing is lost, so nothing more is read
+        std::stringstream in;
+        const std::uint32_t length{64 * 1024 * 1024 + 1};
+        in.write(reinterpret_cast<const char *>(&length), sizeof length);
+        in << frame(R"({"question_id": 42})");
+        std::stringstream out;
+        CPPUNIT_ASSERT(runNativeHost(in, out, true, {}) == 0);
+        CPPUNIT_ASSERT(out.str().empty());
+    }
+
+private:
+    /// `message` with the native messaging length in front
+    static std::string frame(const std::string& message) {
+        const auto length{static_cast<std::uint32_t>(message.size())};
+        return std::string(reinterpret_cast<const char *>(&length), sizeof length) + message;
+    }
+
+    /// the messages framed in `data`
+    static std::vector<std::string> unframe(const std::string& data) {
+        std::vector<std::string> messages;
+        for (std::size_t pos{0}; pos + sizeof(std::uint32_t) <= data.size(); ) {
+            std::uint32_t length;
+            data.copy(reinterpret_cast<char *>(&length), sizeof length, pos);
+            pos += sizeof length;
+            messages.push_back(data.substr(pos, length));
+            pos += length;
+        }
+        return messages;
+    }
+
+    /// write a minimal rules file and templates into `dir` and return a configuration that uses them
+    LangConfig configuration() const {
+        std::ofstream{dir / "rules.txt"} << "<thread>@find_package(Threads)@threads\n";
+        std::ofstream{dir / "top.txt"} << "project({projname})\n";
+        std::ofstream{dir / "src.txt"} << "add_executable({projname} {srcnames})\n";
+        LangConfig config;
+        config.configdir = dir;
+        config.rulesfilename = dir / "rules.txt";
+        config.toplevelcmakefilename = dir / "top.txt";
+        config.srclevelcmakefilename = dir / "src.txt";
+        return config;
+    }
+
+    const fs::path dir{fs::temp_directory_path() / "NativeHostTest"};
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(NativeHostTest);
+
+int main() {
+    CppUnit::TextUi::TestRunner runner;
+    CppUnit::TestFactoryRegistry &registry = CppUnit::TestFactoryRegistry::getRegistry();
+    runner.addTest( registry.makeTest() );
+    bool wasSuccessful = runner.run();
+    std::cout << "wasSuccessful = " << std::boolalpha << wasSuccessful << '\n';
+    return !wasSuccessful;
+}
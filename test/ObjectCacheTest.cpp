@@ -0,0 +1,168 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <cppunit/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include "ObjectCache.h"
+#include "Tool.h"
+
+class ObjectCacheTest : public CppUnit::TestFixture {
+    CPPUNIT_TEST_SUITE(ObjectCacheTest);
+#ifndef _WIN32
+    CPPUNIT_TEST(passThrough);
+    CPPUNIT_TEST(shareAcrossProjects);
+    CPPUNIT_TEST(failedCompile);
+    CPPUNIT_TEST(timeUncached);
+    CPPUNIT_TEST(eviction);
+#endif
+    CPPUNIT_TEST_SUITE_END();
+public:
+    void setUp() {
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+        original = fs::current_path();
+    }
+
+    void tearDown() {
+        fs::current_path(original);
+        fs::remove_all(dir);
+    }
+
+    void passThrough() {
+        if (!Tool::shared("c++")) {
+            return;
+        }
+        project("a", "int main() { return 0; }\n", "");
+        const ObjectCache cache{dir / "cache"};
+        CPPUNIT_ASSERT(cache.compile({"c++", "-E", "src/main.cpp", "-o", "main.ii"}) == 0);
+        CPPUNIT_ASSERT(fs::exists(dir / "a" / "main.ii"));
+        CPPUNIT_ASSERT(cache.compile({"c++", "src/main.cpp", "-o", "main"}) == 0);
+        CPPUNIT_ASSERT(fs::exists(dir / "a" / "main"));
+        CPPUNIT_ASSERT(cache.stats().hits == 0 && cache.stats().misses == 0);
+    }
+
+    void shareAcrossProjects() {
+        if (!Tool::shared("c++")) {
+            return;
+        }
+        const std::string source{"#include \"value.h\"\n#include <vector>\nint main() { return std::vector<int>(value).size() != value; }\n"};
+        const ObjectCache cache{dir / "cache"};
+        project("a", source, "constexpr int value{4};\n");
+        CPPUNIT_ASSERT(cache.compile(compile) == 0);
+        project("b", source, "constexpr int value{4};\n");
+        CPPUNIT_ASSERT(cache.compile(compile) == 0);
+        CPPUNIT_ASSERT(cache.stats().hits == 1 && cache.stats().misses == 1);
+        CPPUNIT_ASSERT(read(dir / "a" / "build" / "main.o") == read(dir / "b" / "build" / "main.o"));
+        // a hit writes the dependency file the compiler would have
+        const auto deps{read(dir / "b" / "build" / "main.o.d")};
+        CPPUNIT_ASSERT(deps.rfind("build/main.o:", 0) == 0);
+        CPPUNIT_ASSERT(deps.find(" src/value.h") != std::string::npos);
+        CPPUNIT_ASSERT(deps.find("\nsrc/value.h:\n") != std::string::npos);
+        CPPUNIT_ASSERT(deps.find("/vector") != std::string::npos);
+
+        // a changed header is a miss, and then both versions are kept
+        project("c", source, "constexpr int value{5};\n");
+        CPPUNIT_ASSERT(cache.compile(compile) == 0);
+        CPPUNIT_ASSERT(read(dir / "c" / "build" / "main.o") != read(dir / "a" / "build" / "main.o"));
+        fs::current_path(dir / "a");
+        CPPUNIT_ASSERT(cache.compile(compile) == 0);
+        CPPUNIT_ASSERT(cache.stats().hits == 2 && cache.stats().misses == 2);
+        cache.resetStats();
+        CPPUNIT_ASSERT(cache.stats().hits == 0 && cache.stats().misses == 0);
+    }
+
+    void failedCompile() {
+        if (!Tool::shared("c++")) {
+            return;
+        }
+        const ObjectCache cache{dir / "cache"};
+        project("a", "int main() { return undeclared; }\n", "");
+        CPPUNIT_ASSERT(cache.compile(compile) != 0);
+        CPPUNIT_ASSERT(!fs::exists(dir / "a" / "build" / "main.o"));
+        CPPUNIT_ASSERT(cache.compile(compile) != 0);
+        CPPUNIT_ASSERT(cache.stats().hits == 0 && cache.stats().misses == 2);
+    }
+
+    void timeUncached() {
+        if (!Tool::shared("c++")) {
+            return;
+        }
+        const ObjectCache cache{dir / "cache"};
+        project("a", "#include \"value.h\"\nint main() { return sizeof stamp; }\n", "const char stamp[]{__TIME__};\n");
+        CPPUNIT_ASSERT(cache.compile(compile) == 0);
+        CPPUNIT_ASSERT(cache.compile(compile) == 0);
+        CPPUNIT_ASSERT(cache.stats().hits == 0 && cache.stats().misses == 2);
+    }
+
+    void eviction() {
+        if (!Tool::shared("c++")) {
+            return;
+        }
+        const ObjectCache cache{dir / "cache"};
+        const std::string source{"#include \"value.h\"\nint main() { return value; }\n"};
+        // many versions of the same source's header, as an edited post might have
+        for (int value{0}; value < 20; ++value) {
+            project("v" + std::to_string(value), source, "constexpr int value{" + std::to_string(value) + "};\n");
+            CPPUNIT_ASSERT(cache.compile(compile) == 0);
+        }
+        std::size_t objects{0};
+        for (const auto& entry : fs::directory_iterator{cache.dir}) {
+            objects += entry.path().extension() == ".o";
+        }
+        CPPUNIT_ASSERT(objects == 16);
+        // the newest are still there, and the counts are two numbers however many compiles there were
+        CPPUNIT_ASSERT(cache.compile(compile) == 0);
+        CPPUNIT_ASSERT(cache.stats().hits == 1 && cache.stats().misses == 20);
+        CPPUNIT_ASSERT(read(cache.dir / "stats") == "1 20\n");
+        // a hit moves its entry to the front, so what is used stays while what is not goes
+        fs::current_path(dir / "v4");
+        CPPUNIT_ASSERT(cache.compile(compile) == 0);
+        for (int value{20}; value < 35; ++value) {
+            project("v" + std::to_string(value), source, "constexpr int value{" + std::to_string(value) + "};\n");
+            CPPUNIT_ASSERT(cache.compile(compile) == 0);
+        }
+        fs::current_path(dir / "v4");
+        CPPUNIT_ASSERT(cache.compile(compile) == 0);
+        fs::current_path(dir / "v5");
+        CPPUNIT_ASSERT(cache.compile(compile) == 0);
+        CPPUNIT_ASSERT(cache.stats().hits == 3 && cache.stats().misses == 36);
+    }
+
+private:
+    static std::string read(const fs::path& filename) {
+        std::stringstream text;
+        text << std::ifstream{filename, std::ios::binary}.rdbuf();
+        return text.str();
+    }
+
+    // make a project `name` with `source` and `header` and make it the current directory
+    void project(const std::string& name, const std::string& source, const std::string& header) const {
+        const auto top{dir / name};
+        fs::create_directories(top / "src");
+        fs::create_directories(top / "build");
+        std::ofstream{top / "src" / "main.cpp"} << source;
+        std::ofstream{top / "src" / "value.h"} << header;
+        fs::current_path(top);
+    }
+
+    const fs::path dir{fs::temp_directory_path() / "ObjectCacheTest"};
+    const std::vector<std::string> compile{"c++", "-MMD", "-MP", "-MF", "build/main.o.d", "-c", "src/main.cpp", "-o", "build/main.o"};
+    fs::path original;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ObjectCacheTest);
+
+int main() {
+    CppUnit::TextUi::TestRunner runner;
+    CppUnit::TestFactoryRegistry &registry = CppUnit::TestFactoryRegistry::getRegistry();
+    runner.addTest( registry.makeTest() );
+    bool wasSuccessful = runner.run();
+    std::cout << "wasSuccessful = " << std::boolalpha << wasSuccessful << '\n';
+    return !wasSuccessful;
+}
@@ -0,0 +1,125 @@
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <iterator>
+#include <fstream>
+#include <string>
+#include <sstream>
+#include <thread>
+#include <cppunit/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include "Process.h"
+
+using namespace std::literals;
+
+class ProcessTest : public CppUnit::TestFixture {
+    CPPUNIT_TEST_SUITE(ProcessTest);
+    CPPUNIT_TEST(status);
+    CPPUNIT_TEST(directory);
+#ifndef _WIN32
+    CPPUNIT_TEST(timeLimit);
+    CPPUNIT_TEST(quoting);
+#endif
+    CPPUNIT_TEST(background);
+    CPPUNIT_TEST(replace);
+    CPPUNIT_TEST_SUITE_END();
+public:
+    void setUp() {
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+    }
+
+    void tearDown() {
+        fs::remove_all(dir);
+    }
+
+    void status() {
+        CPPUNIT_ASSERT(runCommand("exit 0", dir).status == 0);
+        const auto result{runCommand("exit 3", dir)};
+        CPPUNIT_ASSERT(result.status == 3 && !result.timedOut);
+    }
+
+    void directory() {
+        runCommand("echo here > made.txt", dir);
+        std::stringstream text;
+        text << std::ifstream{dir / "made.txt"}.rdbuf();
+        CPPUNIT_ASSERT(text.str().find("here") == 0);
+        CPPUNIT_ASSERT(runCommand("exit 0", dir / "missing").status != 0);
+    }
+
+    void timeLimit() {
+        const auto quick{runCommand("sleep 0.1", dir, 10s)};
+        CPPUNIT_ASSERT(quick.status == 0 && !quick.timedOut);
+        CPPUNIT_ASSERT(quick.elapsed >= 100ms && quick.elapsed < 10s);
+        // whatever the shell started is stopped along with it
+        const auto slow{runCommand("sleep 10; echo late > late.txt", dir, 100ms)};
+        CPPUNIT_ASSERT(slow.timedOut && slow.status == -1);
+        CPPUNIT_ASSERT(slow.elapsed < 5s);
+        CPPUNIT_ASSERT(!fs::exists(dir / "late.txt"));
+    }
+
+    void background() {
+        // the command is still running when startCommand returns
+        const auto start{std::chrono::steady_clock::now()};
+        startCommand("sleep 1 && echo later > later.txt", dir);
+        CPPUNIT_ASSERT(std::chrono::steady_clock::now() - start < 1s);
+        CPPUNIT_ASSERT(!fs::exists(dir / "later.txt"));
+        for (int tries{0}; tries < 100 && !fs::exists(dir / "later.txt"); ++tries) {
+            std::this_thread::sleep_for(100ms);
+        }
+        std::this_thread::sleep_for(100ms);
+        std::stringstream text;
+        text << std::ifstream{dir / "later.txt"}.rdbuf();
+        CPPUNIT_ASSERT(text.str().find("later") == 0);
+    }
+
+    void quoting() {
+        // the shell gives back the argument just as it was
+        const std::string awkward{"a \"b\" $HOME `c` \\d\\"};
+        runCommand("echo " + shellQuoted(awkward) + " > " + shellQuoted(dir / "two words.txt"), dir);
+        CPPUNIT_ASSERT(read(dir / "two words.txt") == awkward + '\n');
+    }
+
+    void replace() {
+        CPPUNIT_ASSERT(uniqueSuffix() != uniqueSuffix());
+        const auto filename{dir / "sub" / "file.txt"};
+        fs::path written;
+        CPPUNIT_ASSERT(replaceFile(filename, [&](const fs::path& tmpfile) {
+            written = tmpfile;
+            std::ofstream{tmpfile} << "first\n";
+            // the file only appears once it is whole
+            return !fs::exists(filename);
+        }));
+        CPPUNIT_ASSERT(read(filename) == "first\n" && !fs::exists(written));
+        // a failed write leaves the old file as it was, and nothing beside it
+        CPPUNIT_ASSERT(!replaceFile(filename, [&](const fs::path& tmpfile) {
+            std::ofstream{tmpfile} << "second\n";
+            return false;
+        }));
+        CPPUNIT_ASSERT(read(filename) == "first\n");
+        CPPUNIT_ASSERT(std::distance(fs::directory_iterator{dir / "sub"}, fs::directory_iterator{}) == 1);
+    }
+
+private:
+    static std::string read(const fs::path& filename) {
+        std::stringstream text;
+        text << std::ifstream{filename}.rdbuf();
+        return text.str();
+    }
+
+    const fs::path dir{fs::temp_directory_path() / "ProcessTest"};
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ProcessTest);
+
+int main() {
+    CppUnit::TextUi::TestRunner runner;
+    CppUnit::TestFactoryRegistry &registry = CppUnit::TestFactoryRegistry::getRegistry();
+    runner.addTest( registry.makeTest() );
+    bool wasSuccessful = runner.run();
+    std::cout << "wasSuccessful = " << std::boolalpha << wasSuccessful << '\n';
+    return !wasSuccessful;
+}
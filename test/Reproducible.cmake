@@ -0,0 +1,60 @@
+# Generate every example project twice, in separate directories, and fail
+# unless each generated file is byte-for-byte the same both times, apart
+# from the name of the directory itself.
+#
+# usage: cmake -Dautoproject=<exe> -Dconfigfile=<conf> -Dexamples=<dir> -Dworkdir=<dir> -P Reproducible.cmake
+foreach(var autoproject configfile examples workdir)
+    if(NOT DEFINED ${var})
+        message(FATAL_ERROR "${var} is not defined")
+    endif()
+endforeach()
+
+# each project is created next to its md file, so each run gets its own copy
+file(GLOB mdfiles ${examples}/*.md)
+file(REMOVE_RECURSE ${workdir})
+foreach(run run1 run2)
+    file(COPY ${mdfiles} DESTINATION ${workdir}/${run})
+    execute_process(
+        COMMAND ${autoproject} --forceoverwrite --configfile ${configfile} --jobs 4 ${workdir}/${run}
+        RESULT_VARIABLE result
+        OUTPUT_QUIET
+    )
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "autoproject failed on the ${run} run: ${result}")
+    endif()
+endforeach()
+
+file(GLOB_RECURSE firstfiles RELATIVE ${workdir}/run1 ${workdir}/run1/*)
+file(GLOB_RECURSE secondfiles RELATIVE ${workdir}/run2 ${workdir}/run2/*)
+list(SORT firstfiles)
+list(SORT secondfiles)
+if(NOT firstfiles STREQUAL secondfiles)
+    message(FATAL_ERROR "the two runs generated different sets of files")
+endif()
+if(NOT firstfiles)
+    message(FATAL_ERROR "no files were generated")
+endif()
+# compile_commands.json names the project directory, which differs
+# between the runs, so each run's own directory is masked out; the
+# manifest records a digest of that file as written, so it is skipped
+function(contents_hash run name result)
+    file(READ ${workdir}/${run}/${name} text)
+    string(REPLACE "${workdir}/${run}" "<dir>" text "${text}")
+    string(SHA256 hash "${text}")
+    set(${result} ${hash} PARENT_SCOPE)
+endfunction()
+set(differences 0)
+list(FILTER firstfiles EXCLUDE REGEX "(^|/)autoproject\\.manifest$")
+foreach(name ${firstfiles})
+    contents_hash(run1 ${name} firsthash)
+    contents_hash(run2 ${name} secondhash)
+    if(NOT firsthash STREQUAL secondhash)
+        message(SEND_ERROR "${name} differs between runs")
+        math(EXPR differences "${differences} + 1")
+    endif()
+endforeach()
+list(LENGTH firstfiles count)
+if(differences)
+    message(FATAL_ERROR "${differences} of ${count} generated files are not reproducible")
+endif()
+message(STATUS "all ${count} generated files are reproducible")
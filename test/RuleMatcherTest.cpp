@@ -0,0 +1,95 @@
+#include <iostream>
+#include <iomanip>
+#include <regex>
+#include <string>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include <cppunit/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include "RuleMatcher.h"
+
+class RuleMatcherTest : public CppUnit::TestFixture {
+    CPPUNIT_TEST_SUITE(RuleMatcherTest);
+    CPPUNIT_TEST(prefilter);
+    CPPUNIT_TEST(multipleMatches);
+    CPPUNIT_TEST(noLiteral);
+    CPPUNIT_TEST(sameAsRegex);
+    CPPUNIT_TEST_SUITE_END();
+public:
+    void prefilter() {
+        auto matcher{makeMatcher(patterns)};
+        CPPUNIT_ASSERT(matcher.prefilter() == "#include");
+        CPPUNIT_ASSERT(matcher.match("int main() { return 0; }").empty());
+        CPPUNIT_ASSERT(matcher.match("// filesystem> thread").empty());
+    }
+
+    void multipleMatches() {
+        auto matcher{makeMatcher(patterns)};
+        CPPUNIT_ASSERT(matcher.match("#include <experimental/filesystem>") == std::vector<std::size_t>{0});
+        CPPUNIT_ASSERT(matcher.match("  #include <future>") == std::vector<std::size_t>{1});
+        CPPUNIT_ASSERT(matcher.match("#include <SDL2/SDL.h>") == std::vector<std::size_t>{3});
+        CPPUNIT_ASSERT(matcher.match("#include <SDL2/SDL_ttf.h>") == std::vector<std::size_t>{2});
+        CPPUNIT_ASSERT((matcher.match("#include <thread> // #include <png.h>") == std::vector<std::size_t>{1, 4}));
+        CPPUNIT_ASSERT(matcher.match("#include \"png.h\"").empty());
+    }
+
+    void noLiteral() {
+        auto matcher{makeMatcher({R"(\s*#include\s*<png.h>)", R"(foo|bar)", R"(\d+)"})};
+        CPPUNIT_ASSERT(matcher.prefilter().empty());
+        CPPUNIT_ASSERT((matcher.match("bar 42") == std::vector<std::size_t>{1, 2}));
+        CPPUNIT_ASSERT(matcher.match("#include <png.h>") == std::vector<std::size_t>{0});
+    }
+
+    void sameAsRegex() {
+        const std::vector<std::string> more{
+            R"(a(bc|de)+f)", R"((?:xy)?z{2,})", R"(q\.r[st]u)", R"(^begin)", R"(end$)", R"(\bword\b)",
+        };
+        auto matcher{makeMatcher(more)};
+        const std::vector<std::string> lines{
+            "abcf", "abcdef", "af", "zz", "xyz", "xyzz", "q.rsu", "qxrsu", "begin here", " begin",
+            "the end", "end.", "a word", "swordfish", "",
+        };
+        for (const auto& line : lines) {
+            std::vector<std::size_t> expected;
+            for (std::size_t id{0}; id < more.size(); ++id) {
+                if (std::regex_search(line, std::regex{more[id]})) {
+                    expected.push_back(id);
+                }
+            }
+            CPPUNIT_ASSERT(matcher.match(line) == expected);
+        }
+    }
+
+private:
+    static RuleMatcher makeMatcher(const std::vector<std::string>& patterns) {
+        RuleMatcher matcher;
+        for (const auto& pattern : patterns) {
+            matcher.add(pattern);
+        }
+        matcher.compile();
+        return matcher;
+    }
+
+    const std::vector<std::string> patterns{
+        R"(\s*#include\s*<(experimental/)?filesystem>)",
+        R"(\s*#include\s*<(thread|future)>)",
+        R"(\s*#include\s*<SDL2/SDL_ttf.h>)",
+        R"(\s*#include\s*<SDL2/SDL.h>)",
+        R"(\s*#include\s*<png.h>)",
+    };
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(RuleMatcherTest);
+
+int main() {
+    CppUnit::TextUi::TestRunner runner;
+    CppUnit::TestFactoryRegistry &registry = CppUnit::TestFactoryRegistry::getRegistry();
+    runner.addTest( registry.makeTest() );
+    bool wasSuccessful = runner.run();
+    std::cout << "wasSuccessful = " << std::boolalpha << wasSuccessful << '\n';
+    return !wasSuccessful;
+}
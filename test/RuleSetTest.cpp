@@ -0,0 +1,113 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <cppunit/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include "RuleSet.h"
+
+class RuleSetTest : public CppUnit::TestFixture {
+    CPPUNIT_TEST_SUITE(RuleSetTest);
+    CPPUNIT_TEST(load);
+    CPPUNIT_TEST(shared);
+    CPPUNIT_TEST(ruleOrder);
+    CPPUNIT_TEST(concurrentMatch);
+    CPPUNIT_TEST_SUITE_END();
+public:
+    void setUp() {
+        fs::create_directories(dir);
+        std::ofstream{dir / "rules.txt"}
+            << "# comment\n"
+            << "<thread>@find_package(Threads)@threads@-pthread\n"
+            << "<future>@find_package(Threads)@threads\n"
+            << "\\s*#include\\s*\"zlib.h\"@@z\n"
+            << "<png.h>@find_package(PNG)\\nset(X 1)@png\n";
+    }
+
+    void tearDown() {
+        fs::remove_all(dir);
+    }
+
+    void load() {
+        const RuleSet rules{dir / "rules.txt"};
+        CPPUNIT_ASSERT(rules.size() == 4);
+        CPPUNIT_ASSERT(rules.match("int x;").empty());
+        CPPUNIT_ASSERT(rules.match("// #include <thread>").empty());
+        auto found{rules.match("  #  include <png.h>")};
+        CPPUNIT_ASSERT(found.size() == 1);
+        CPPUNIT_ASSERT(rules[found[0]].cmake == "find_package(PNG)\nset(X 1)");
+        CPPUNIT_ASSERT(rules[found[0]].libraries == "png");
+        found = rules.match("#include \"zlib.h\"");
+        CPPUNIT_ASSERT(found.size() == 1 && rules[found[0]].libraries == "z" && rules[found[0]].flags.empty());
+        found = rules.match("#include <thread>");
+        CPPUNIT_ASSERT(found.size() == 1 && rules[found[0]].libraries == "threads" && rules[found[0]].flags == "-pthread");
+        CPPUNIT_ASSERT(includedHeader("#include <a/b.h> // c") == "a/b.h");
+        CPPUNIT_ASSERT(includedHeader("#include \"a.h\"").empty());
+    }
+
+    void shared() {
+        auto first{RuleSet::shared(dir / "rules.txt")};
+        auto second{RuleSet::shared(dir / "rules.txt")};
+        CPPUNIT_ASSERT(first == second);
+        CPPUNIT_ASSERT(first->size() == 4);
+        // an edited rules file is loaded again
+        std::ofstream{dir / "rules.txt", std::ios::app} << "<regex>@@@\n";
+        const auto edited{RuleSet::shared(dir / "rules.txt")};
+        CPPUNIT_ASSERT(edited != first && edited->size() == 5);
+        CPPUNIT_ASSERT(RuleSet::shared(dir / "rules.txt") == edited);
+    }
+
+    void ruleOrder() {
+        std::ofstream{dir / "order.txt"}
+            << "#include\\s*<thread>@regex@\n"
+            << "<thread>@header@\n"
+            << "thread@word@\n";
+        const RuleSet rules{dir / "order.txt"};
+        const auto found{rules.match("#include <thread>")};
+        CPPUNIT_ASSERT((found == std::vector<std::size_t>{0, 1, 2}));
+        CPPUNIT_ASSERT(rules[1].cmake == "header");
+    }
+
+    void concurrentMatch() {
+        auto rules{RuleSet::shared(dir / "rules.txt")};
+        const std::vector<std::string> lines{
+            "#include <thread>", "#include <future>", "#include \"zlib.h\"", "#include <png.h>", "int main() {}",
+        };
+        std::vector<std::size_t> counts(8);
+        std::vector<std::thread> threads;
+        for (unsigned t{0}; t < counts.size(); ++t) {
+            threads.emplace_back([&, t]{
+                for (unsigned n{0}; n < 2000; ++n) {
+                    counts[t] += rules->match(lines[(n + t) % lines.size()]).size();
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        for (const auto count : counts) {
+            CPPUNIT_ASSERT(count == 1600);
+        }
+    }
+
+private:
+    const fs::path dir{fs::temp_directory_path() / "RuleSetTest"};
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(RuleSetTest);
+
+int main() {
+    CppUnit::TextUi::TestRunner runner;
+    CppUnit::TestFactoryRegistry &registry = CppUnit::TestFactoryRegistry::getRegistry();
+    runner.addTest( registry.makeTest() );
+    bool wasSuccessful = runner.run();
+    std::cout << "wasSuccessful = " << std::boolalpha << wasSuccessful << '\n';
+    return !wasSuccessful;
+}
@@ -0,0 +1,95 @@
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <sstream>
+#include <stdexcept>
+#include <cppunit/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include "SharedHeader.h"
+#include "Tool.h"
+
+class SharedHeaderTest : public CppUnit::TestFixture {
+    CPPUNIT_TEST_SUITE(SharedHeaderTest);
+    CPPUNIT_TEST(nothingToBuild);
+#ifndef _WIN32
+    CPPUNIT_TEST(build);
+    CPPUNIT_TEST(failure);
+#endif
+    CPPUNIT_TEST_SUITE_END();
+public:
+    void setUp() {
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+    }
+
+    void tearDown() {
+        fs::remove_all(dir);
+    }
+
+    void nothingToBuild() {
+        const Tool sh{"sh"};
+        CPPUNIT_ASSERT(SharedHeader(sh, "", "<vector>", true, {}).header.empty());
+        CPPUNIT_ASSERT(SharedHeader(sh, "", "", true, dir).header.empty());
+        CPPUNIT_ASSERT(fs::is_empty(dir));
+    }
+
+    void build() {
+        const auto compiler{Tool::shared("c++")};
+        if (!compiler) {
+            return;
+        }
+        const SharedHeader built{*compiler, "-std=c++17", "<vector> <string>", true, dir};
+        CPPUNIT_ASSERT(fs::exists(built.header) && fs::exists(built.precompiled));
+        std::stringstream text;
+        text << std::ifstream{built.header}.rdbuf();
+        CPPUNIT_ASSERT(text.str().find("#include <vector>\n#include <string>\n") != std::string::npos);
+        // once built, it is only found again
+        const auto time{fs::last_write_time(built.precompiled)};
+        const SharedHeader again{*compiler, "-std=c++17", "<vector> <string>", true, dir};
+        CPPUNIT_ASSERT(again.precompiled == built.precompiled);
+        CPPUNIT_ASSERT(fs::last_write_time(again.precompiled) == time);
+        // but other flags need a header of their own
+        const SharedHeader other{*compiler, "-std=c++14", "<vector> <string>", true, dir};
+        CPPUNIT_ASSERT(!other.header.empty() && other.header.parent_path() != built.header.parent_path());
+        const auto shared{SharedHeader::shared(*compiler, "-std=c++17", "<vector> <string>", true, dir)};
+        CPPUNIT_ASSERT(shared && shared == SharedHeader::shared(*compiler, "-std=c++17", "<vector> <string>", true, dir));
+        CPPUNIT_ASSERT(shared->precompiled == built.precompiled);
+    }
+
+    void failure() {
+        const auto program{dir / "badcc"};
+        std::ofstream{program} << "#!/bin/sh\nexit 1\n";
+        fs::permissions(program, fs::perms::owner_all);
+        const Tool compiler{program.string()};
+        CPPUNIT_ASSERT(SharedHeader(compiler, "", "<vector>", true, dir / "cache").header.empty());
+        CPPUNIT_ASSERT(!SharedHeader::shared(compiler, "", "<vector>", true, dir / "cache"));
+        // a working compiler of the same name is not tried again until its version changes
+        std::ofstream{program} << "#!/bin/sh\nexit 0\n";
+        CPPUNIT_ASSERT(SharedHeader(compiler, "", "<vector>", true, dir / "cache").header.empty());
+        // once it does, it is tried afresh, even by a process that remembers the old one failing
+        std::ofstream{program} << "#!/bin/sh\n[ \"$1\" = --version ] && echo badcc 2 && exit 0\n"
+            << "while [ $# -gt 1 ]; do [ \"$1\" = -o ] && : > \"$2\"; shift; done\nexit 0\n";
+        const Tool upgraded{program.string()};
+        CPPUNIT_ASSERT(upgraded.digest() != compiler.digest());
+        CPPUNIT_ASSERT(SharedHeader::shared(upgraded, "", "<vector>", true, dir / "cache"));
+    }
+
+private:
+    const fs::path dir{fs::temp_directory_path() / "SharedHeaderTest"};
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SharedHeaderTest);
+
+int main() {
+    CppUnit::TextUi::TestRunner runner;
+    CppUnit::TestFactoryRegistry &registry = CppUnit::TestFactoryRegistry::getRegistry();
+    runner.addTest( registry.makeTest() );
+    bool wasSuccessful = runner.run();
+    std::cout << "wasSuccessful = " << std::boolalpha << wasSuccessful << '\n';
+    return !wasSuccessful;
+}
@@ -0,0 +1,71 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <sstream>
+#include <stdexcept>
+#include <cppunit/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include "Template.h"
+
+class TemplateTest : public CppUnit::TestFixture {
+    CPPUNIT_TEST_SUITE(TemplateTest);
+    CPPUNIT_TEST(placeholders);
+    CPPUNIT_TEST(otherBraces);
+    CPPUNIT_TEST(newlines);
+    CPPUNIT_TEST(shared);
+    CPPUNIT_TEST_SUITE_END();
+public:
+    void placeholders() {
+        const Template tmpl{"add_executable({projname} {srcnames})\n{extras}target_link_libraries({projname}{libraries})\n"};
+        CPPUNIT_ASSERT(tmpl.render({"p", "a.cpp b.cpp", "find_package(X)\n", " x"})
+            == "add_executable(p a.cpp b.cpp)\nfind_package(X)\ntarget_link_libraries(p x)\n");
+        CPPUNIT_ASSERT(tmpl.render({"p", {}, {}, {}}) == "add_executable(p )\ntarget_link_libraries(p)\n");
+        const Template pch{"add_executable({projname})\n{precompiled}"};
+        CPPUNIT_ASSERT(pch.render({"p", {}, {}, {}, "target_precompile_headers(p PRIVATE <vector>)\n"})
+            == "add_executable(p)\ntarget_precompile_headers(p PRIVATE <vector>)\n\n");
+        const Template programs{"add_executable({projname})\n{programs}{precompiled}"};
+        CPPUNIT_ASSERT(programs.render({"p", {}, {}, {}, "pch\n", "add_executable(q)\n"})
+            == "add_executable(p)\nadd_executable(q)\npch\n\n");
+    }
+
+    void otherBraces() {
+        const Template tmpl{"set(X ${Y}) {{projname}} {projnam} {projname"};
+        CPPUNIT_ASSERT(tmpl.render({"p", {}, {}, {}}) == "set(X ${Y}) {p} {projnam} {projname\n");
+    }
+
+    void newlines() {
+        CPPUNIT_ASSERT(Template{""}.render({"p", {}, {}, {}}).empty());
+        CPPUNIT_ASSERT(Template{"{projname}"}.render({"p", {}, {}, {}}) == "p\n");
+        CPPUNIT_ASSERT(Template{"a\r\n{projname}\r\n"}.render({"p", {}, {}, {}}) == "a\r\np\r\n");
+    }
+
+    void shared() {
+        const fs::path filename{fs::temp_directory_path() / "TemplateTest.txt"};
+        std::ofstream{filename} << "project({projname})\n";
+        auto first{Template::shared(filename)};
+        auto second{Template::shared(filename)};
+        CPPUNIT_ASSERT(first && first == second);
+        CPPUNIT_ASSERT(first->render({"p", {}, {}, {}}) == "project(p)\n");
+        CPPUNIT_ASSERT(!Template::shared(filename.string() + ".missing"));
+        // an edited template is read again
+        std::ofstream{filename} << "project({projname} CXX)\n";
+        const auto edited{Template::shared(filename)};
+        CPPUNIT_ASSERT(edited != first && edited->render({"p", {}, {}, {}}) == "project(p CXX)\n");
+        fs::remove(filename);
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TemplateTest);
+
+int main() {
+    CppUnit::TextUi::TestRunner runner;
+    CppUnit::TestFactoryRegistry &registry = CppUnit::TestFactoryRegistry::getRegistry();
+    runner.addTest( registry.makeTest() );
+    bool wasSuccessful = runner.run();
+    std::cout << "wasSuccessful = " << std::boolalpha << wasSuccessful << '\n';
+    return !wasSuccessful;
+}
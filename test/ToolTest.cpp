@@ -0,0 +1,83 @@
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <sstream>
+#include <stdexcept>
+#include <cppunit/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include "Tool.h"
+
+class ToolTest : public CppUnit::TestFixture {
+    CPPUNIT_TEST_SUITE(ToolTest);
+    CPPUNIT_TEST(missing);
+#ifndef _WIN32
+    CPPUNIT_TEST(searchPath);
+    CPPUNIT_TEST(cache);
+#endif
+    CPPUNIT_TEST_SUITE_END();
+public:
+    void setUp() {
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+    }
+
+    void tearDown() {
+        fs::remove_all(dir);
+    }
+
+    void missing() {
+        CPPUNIT_ASSERT(!Tool::shared("no-such-program-for-autoproject"));
+        CPPUNIT_ASSERT(Tool{(dir / "nothing").string()}.path.empty());
+    }
+
+    void searchPath() {
+        const auto sh{Tool::shared("sh")};
+        CPPUNIT_ASSERT(sh && sh->path.is_absolute() && fs::exists(sh->path));
+        CPPUNIT_ASSERT(Tool::shared("sh") == sh);
+    }
+
+    void cache() {
+        const auto program{dir / "fakecc"};
+        std::ofstream{program} << "#!/bin/sh\necho fakecc 1.0\necho second line\n";
+        fs::permissions(program, fs::perms::owner_all);
+        const auto cachedir{dir / "cache"};
+        const Tool probed{program.string(), cachedir};
+        CPPUNIT_ASSERT(probed.version == "fakecc 1.0");
+        const auto shared{Tool::shared(program.string(), cachedir)};
+        CPPUNIT_ASSERT(shared && Tool::shared(program.string(), cachedir) == shared);
+        // the version now comes from the cache, so a doctored cache shows through
+        const auto cachefile{fs::directory_iterator{cachedir}->path()};
+        std::stringstream contents;
+        contents << std::ifstream{cachefile}.rdbuf();
+        auto text{contents.str()};
+        text.replace(text.find("fakecc 1.0"), 10, "fakecc 0.9");
+        std::ofstream{cachefile} << text;
+        CPPUNIT_ASSERT(Tool(program.string(), cachedir).version == "fakecc 0.9");
+        // until the program changes
+        std::ofstream{program} << "#!/bin/sh\necho fakecc 2.0\n";
+        fs::last_write_time(program, fs::last_write_time(program) + std::chrono::seconds{1});
+        const Tool changed{program.string(), cachedir};
+        CPPUNIT_ASSERT(changed.version == "fakecc 2.0");
+        CPPUNIT_ASSERT(changed.digest() != probed.digest());
+        CPPUNIT_ASSERT(Tool::shared(program.string(), cachedir)->version == "fakecc 2.0");
+    }
+
+private:
+    const fs::path dir{fs::temp_directory_path() / "ToolTest"};
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ToolTest);
+
+int main() {
+    CppUnit::TextUi::TestRunner runner;
+    CppUnit::TestFactoryRegistry &registry = CppUnit::TestFactoryRegistry::getRegistry();
+    runner.addTest( registry.makeTest() );
+    bool wasSuccessful = runner.run();
+    std::cout << "wasSuccessful = " << std::boolalpha << wasSuccessful << '\n';
+    return !wasSuccessful;
+}